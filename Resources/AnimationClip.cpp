@@ -0,0 +1,359 @@
+// Baked and compressed animation clip.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Resources/AnimationClip.h>
+
+#include <Math/Matrix.h>
+#include <Scene/TransformationNode.h>
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace OpenEngine {
+namespace Resources {
+
+using OpenEngine::Math::Matrix;
+
+static const float SQRT2 = 1.41421356f;
+
+// Helper to interpolate between two samples of the given width,
+// optionally normalizing the result (for quaternions).
+static void Interpolate(const float* a, const float* b, float t,
+                        unsigned int width, bool normalize, float* out) {
+    float len = 0.0;
+    for (unsigned int i = 0; i < width; i++) {
+        out[i] = a[i] + (b[i] - a[i]) * t;
+        len += out[i] * out[i];
+    }
+    if (normalize && len > 0.0f) {
+        len = sqrt(len);
+        for (unsigned int i = 0; i < width; i++)
+            out[i] /= len;
+    }
+}
+
+/**
+ * Clip constructor.
+ *
+ * @param name Clip name.
+ * @param rate Sample rate in frames per second.
+ * @param frames Number of frames, at most MAX_FRAMES.
+ */
+AnimationClip::AnimationClip(string name, float rate, unsigned int frames)
+    : name(name), rate(rate), frameCount(frames) {
+    if (frameCount > MAX_FRAMES)
+        frameCount = MAX_FRAMES;
+    if (frameCount == 0)
+        frameCount = 1;
+}
+
+AnimationClip::~AnimationClip() {}
+
+/**
+ * Add a position or scale track.
+ *
+ * @param nodes Nodes to animate.
+ * @param type TRACK_POSITION or TRACK_SCALE.
+ * @param samples One sample per frame.
+ * @param tolerance Maximum error per component when removing keys.
+ */
+void AnimationClip::AddVectorTrack(const vector<TransformationNode*>& nodes, TrackType type,
+                                   const vector<Vector<3,float> >& samples, float tolerance) {
+    unsigned int count = samples.size() < frameCount ? samples.size() : frameCount;
+    if (count == 0)
+        return;
+
+    vector<float> flat(count * 3);
+    for (unsigned int f = 0; f < count; f++)
+        for (unsigned int i = 0; i < 3; i++)
+            flat[f*3+i] = samples[f][i];
+
+    vector<unsigned int> keys;
+    ReduceKeys(flat, 3, false, tolerance, keys);
+
+    Track t;
+    t.firstNode = this->nodes.size();
+    t.nodeCount = nodes.size();
+    this->nodes.insert(this->nodes.end(), nodes.begin(), nodes.end());
+    t.type = type;
+    t.firstKey = keyFrames.size();
+    t.keyCount = keys.size();
+    t.dataOffset = data.size();
+    tracks.push_back(t);
+
+    data.resize(data.size() + keys.size() * VECTOR_KEY_SIZE);
+    for (unsigned int k = 0; k < keys.size(); k++) {
+        keyFrames.push_back(keys[k]);
+        memcpy(&data[t.dataOffset + k * VECTOR_KEY_SIZE], &flat[keys[k]*3], VECTOR_KEY_SIZE);
+    }
+}
+
+/**
+ * Add a rotation track.
+ *
+ * @param nodes Nodes to animate.
+ * @param samples One sample per frame.
+ * @param tolerance Maximum error per quaternion component when
+ *                  removing keys.
+ */
+void AnimationClip::AddRotationTrack(const vector<TransformationNode*>& nodes,
+                                     const vector<Quaternion<float> >& samples, float tolerance) {
+    unsigned int count = samples.size() < frameCount ? samples.size() : frameCount;
+    if (count == 0)
+        return;
+
+    // store as (w,x,y,z) and keep the sign continuous so
+    // interpolation takes the short way
+    vector<float> flat(count * 4);
+    for (unsigned int f = 0; f < count; f++) {
+        Quaternion<float> q = samples[f];
+        Vector<3,float> im = q.GetImaginary();
+        float* d = &flat[f*4];
+        d[0] = q.GetReal(); d[1] = im[0]; d[2] = im[1]; d[3] = im[2];
+        float len = sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2] + d[3]*d[3]);
+        if (len > 0.0f)
+            for (unsigned int i = 0; i < 4; i++) d[i] /= len;
+        if (f > 0) {
+            float* p = &flat[(f-1)*4];
+            if (p[0]*d[0] + p[1]*d[1] + p[2]*d[2] + p[3]*d[3] < 0.0f)
+                for (unsigned int i = 0; i < 4; i++) d[i] = -d[i];
+        }
+    }
+
+    vector<unsigned int> keys;
+    ReduceKeys(flat, 4, true, tolerance, keys);
+
+    Track t;
+    t.firstNode = this->nodes.size();
+    t.nodeCount = nodes.size();
+    this->nodes.insert(this->nodes.end(), nodes.begin(), nodes.end());
+    t.type = TRACK_ROTATION;
+    t.firstKey = keyFrames.size();
+    t.keyCount = keys.size();
+    t.dataOffset = data.size();
+    tracks.push_back(t);
+
+    data.resize(data.size() + keys.size() * ROTATION_KEY_SIZE);
+    for (unsigned int k = 0; k < keys.size(); k++) {
+        keyFrames.push_back(keys[k]);
+        EncodeRotation(&flat[keys[k]*4], &data[t.dataOffset + k * ROTATION_KEY_SIZE]);
+    }
+}
+
+/**
+ * Greedily remove samples that are reproduced by interpolating the
+ * surrounding keys within the tolerance. The first and last samples
+ * are always kept.
+ *
+ * Every sample inside a segment limits the slope of a line from the
+ * last key to an interval per component. The intervals are narrowed
+ * as the segment grows, so extending it only checks the slope to the
+ * new end, and the pass is linear in the number of samples.
+ * Normalizing moves an interpolated value by at most the distance of
+ * the segment midpoint to the unit sphere, so for normalized samples
+ * the tolerance is split between the two errors.
+ */
+void AnimationClip::ReduceKeys(const vector<float>& samples, unsigned int width,
+                               bool normalize, float tolerance, vector<unsigned int>& keys) {
+    unsigned int count = samples.size() / width;
+    float tol = normalize ? tolerance * 0.5f : tolerance;
+    float lo[4], hi[4];
+    for (unsigned int c = 0; c < width; c++) {
+        lo[c] = -FLT_MAX;
+        hi[c] = FLT_MAX;
+    }
+    keys.push_back(0);
+    unsigned int last = 0;
+    for (unsigned int f = 1; f + 1 < count; f++) {
+        // the slopes keeping f within the tolerance
+        const float* a = &samples[last*width];
+        const float* s = &samples[f*width];
+        float d = float(f - last);
+        for (unsigned int c = 0; c < width; c++) {
+            float l = (s[c] - tol - a[c]) / d;
+            float h = (s[c] + tol - a[c]) / d;
+            if (l > lo[c]) lo[c] = l;
+            if (h < hi[c]) hi[c] = h;
+        }
+
+        // can the segment from the last key be extended to f+1?
+        const float* e = &samples[(f+1)*width];
+        float n = float(f + 1 - last);
+        bool ok = true;
+        for (unsigned int c = 0; c < width && ok; c++) {
+            float slope = (e[c] - a[c]) / n;
+            ok = slope >= lo[c] && slope <= hi[c];
+        }
+        if (ok && normalize) {
+            float len = 0.0;
+            for (unsigned int c = 0; c < width; c++)
+                len += (a[c] + e[c]) * (a[c] + e[c]) * 0.25f;
+            ok = 1.0f - sqrt(len) <= tol;
+        }
+        if (!ok) {
+            keys.push_back(f);
+            last = f;
+            for (unsigned int c = 0; c < width; c++) {
+                lo[c] = -FLT_MAX;
+                hi[c] = FLT_MAX;
+            }
+        }
+    }
+    if (count > 1)
+        keys.push_back(count - 1);
+}
+
+/**
+ * Quantize a unit quaternion to 48 bits. The largest component is
+ * dropped (it is recomputed when decoding), the three others are
+ * stored with 15 bits each and the index of the dropped component is
+ * kept in the top bits of the first two values.
+ */
+void AnimationClip::EncodeRotation(const float q[4], unsigned char* dest) {
+    unsigned int largest = 0;
+    for (unsigned int i = 1; i < 4; i++)
+        if (fabs(q[i]) > fabs(q[largest]))
+            largest = i;
+    float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+
+    unsigned short v[3];
+    for (unsigned int i = 0, j = 0; i < 4; i++) {
+        if (i == largest)
+            continue;
+        // the remaining components lie in [-1/sqrt(2);1/sqrt(2)]
+        float c = q[i] * sign * SQRT2;
+        if (c > 1.0f) c = 1.0f;
+        if (c < -1.0f) c = -1.0f;
+        v[j++] = (unsigned short)((c + 1.0f) * 0.5f * 32767.0f + 0.5f);
+    }
+    v[0] |= (largest >> 1) << 15;
+    v[1] |= (largest & 1) << 15;
+    memcpy(dest, v, ROTATION_KEY_SIZE);
+}
+
+void AnimationClip::DecodeRotation(const unsigned char* src, float q[4]) {
+    unsigned short v[3];
+    memcpy(v, src, ROTATION_KEY_SIZE);
+    unsigned int largest = ((v[0] >> 15) << 1) | (v[1] >> 15);
+    float sum = 0.0;
+    for (unsigned int i = 0, j = 0; i < 4; i++) {
+        if (i == largest)
+            continue;
+        float c = float(v[j++] & 0x7FFF) / 32767.0f * 2.0f - 1.0f;
+        q[i] = c / SQRT2;
+        sum += q[i] * q[i];
+    }
+    q[largest] = sum < 1.0f ? sqrt(1.0f - sum) : 0.0f;
+}
+
+/**
+ * Find the last key of a track at or before the given frame.
+ */
+unsigned int AnimationClip::FindKey(const Track& t, float frame) {
+    unsigned int lo = 0, hi = t.keyCount;
+    while (lo < hi) {
+        unsigned int mid = (lo + hi) / 2;
+        if (keyFrames[t.firstKey + mid] <= frame)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo > 0 ? lo - 1 : 0;
+}
+
+/**
+ * Set the transformation nodes of all tracks to their state at the
+ * given time. The time is clamped to the clip.
+ *
+ * @param time Time in seconds from the start of the clip.
+ */
+void AnimationClip::Apply(float time) {
+    float frame = time * rate;
+    if (frame < 0.0f) frame = 0.0f;
+    if (frame > float(frameCount - 1)) frame = float(frameCount - 1);
+
+    for (vector<Track>::iterator itr = tracks.begin(); itr != tracks.end(); itr++) {
+        const Track& t = *itr;
+        unsigned int k = FindKey(t, frame);
+        unsigned int n = k + 1 < t.keyCount ? k + 1 : k;
+        float f0 = keyFrames[t.firstKey + k], f1 = keyFrames[t.firstKey + n];
+        float s = f1 > f0 ? (frame - f0) / (f1 - f0) : 0.0f;
+
+        if (t.type == TRACK_ROTATION) {
+            float a[4], b[4], q[4];
+            DecodeRotation(&data[t.dataOffset + k * ROTATION_KEY_SIZE], a);
+            DecodeRotation(&data[t.dataOffset + n * ROTATION_KEY_SIZE], b);
+            // the encoding may flip signs, interpolate the short way
+            if (a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3] < 0.0f)
+                for (unsigned int i = 0; i < 4; i++) b[i] = -b[i];
+            Interpolate(a, b, s, 4, true, q);
+            Quaternion<float> rot(q[0], q[1], q[2], q[3]);
+            for (unsigned int i = 0; i < t.nodeCount; i++)
+                nodes[t.firstNode + i]->SetRotation(rot);
+            continue;
+        }
+
+        float a[3], b[3], v[3];
+        memcpy(a, &data[t.dataOffset + k * VECTOR_KEY_SIZE], VECTOR_KEY_SIZE);
+        memcpy(b, &data[t.dataOffset + n * VECTOR_KEY_SIZE], VECTOR_KEY_SIZE);
+        Interpolate(a, b, s, 3, false, v);
+        for (unsigned int i = 0; i < t.nodeCount; i++) {
+            TransformationNode* node = nodes[t.firstNode + i];
+            if (t.type == TRACK_POSITION)
+                node->SetPosition(Vector<3,float>(v[0], v[1], v[2]));
+            else
+                node->SetScale(Matrix<4,4,float>(v[0],0,0,0,
+                                                 0,v[1],0,0,
+                                                 0,0,v[2],0,
+                                                 0,0,0,1));
+        }
+    }
+}
+
+string AnimationClip::GetName() {
+    return name;
+}
+
+/**
+ * Duration of the clip in seconds.
+ */
+float AnimationClip::GetDuration() {
+    return (frameCount - 1) / rate;
+}
+
+float AnimationClip::GetSampleRate() {
+    return rate;
+}
+
+unsigned int AnimationClip::GetFrameCount() {
+    return frameCount;
+}
+
+unsigned int AnimationClip::GetTrackCount() {
+    return tracks.size();
+}
+
+/**
+ * Number of keys left in all tracks after compression.
+ */
+unsigned int AnimationClip::GetKeyCount() {
+    return keyFrames.size();
+}
+
+/**
+ * Size of the key data in bytes.
+ */
+unsigned int AnimationClip::GetSize() {
+    return data.size() + keyFrames.size() * sizeof(unsigned short)
+        + tracks.size() * sizeof(Track) + nodes.size() * sizeof(TransformationNode*);
+}
+
+} // NS Resources
+} // NS OpenEngine
@@ -0,0 +1,104 @@
+// Baked and compressed animation clip.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _ANIMATION_CLIP_H_
+#define _ANIMATION_CLIP_H_
+
+#include <Math/Vector.h>
+#include <Math/Quaternion.h>
+
+#include <string>
+#include <vector>
+
+namespace OpenEngine {
+    namespace Scene {
+        class TransformationNode;
+    }
+
+namespace Resources {
+
+using OpenEngine::Scene::TransformationNode;
+using OpenEngine::Math::Vector;
+using OpenEngine::Math::Quaternion;
+using namespace std;
+
+/**
+ * Animation clip baked to a fixed sample rate.
+ *
+ * Each track animates the position, rotation or scale of the
+ * transformation nodes created for one element, one node for each
+ * instance of the element. Keys that can be reproduced by
+ * interpolating their neighbours within the error tolerance are
+ * removed, and rotations are quantized to 48 bits using the smallest
+ * three encoding. All key data of the clip lives in one contiguous buffer
+ * in track order, and Apply() walks the tracks front to back.
+ *
+ * @class AnimationClip AnimationClip.h "AnimationClip.h"
+ */
+class AnimationClip {
+public:
+    enum TrackType {
+        TRACK_POSITION,
+        TRACK_ROTATION,
+        TRACK_SCALE
+    };
+
+    static const unsigned int MAX_FRAMES = 65535;
+
+    AnimationClip(string name, float rate, unsigned int frames);
+    virtual ~AnimationClip();
+
+    void AddVectorTrack(const vector<TransformationNode*>& nodes, TrackType type,
+                        const vector<Vector<3,float> >& samples, float tolerance);
+    void AddRotationTrack(const vector<TransformationNode*>& nodes,
+                          const vector<Quaternion<float> >& samples, float tolerance);
+
+    void Apply(float time);
+
+    string GetName();
+    float GetDuration();
+    float GetSampleRate();
+    unsigned int GetFrameCount();
+    unsigned int GetTrackCount();
+    unsigned int GetKeyCount();
+    unsigned int GetSize();
+
+private:
+    struct Track {
+        unsigned int firstNode;   //!< index of the first animated node
+        unsigned int nodeCount;
+        TrackType type;
+        unsigned int firstKey;    //!< index of the first key frame
+        unsigned int keyCount;
+        unsigned int dataOffset;  //!< byte offset of the first key
+    };
+
+    static const unsigned int VECTOR_KEY_SIZE = 12;
+    static const unsigned int ROTATION_KEY_SIZE = 6;
+
+    string name;
+    float rate;
+    unsigned int frameCount;
+
+    vector<Track> tracks;
+    vector<TransformationNode*> nodes; //!< animated nodes of all tracks
+    vector<unsigned short> keyFrames; //!< frame index of each key
+    vector<unsigned char> data;       //!< key data of all tracks
+
+    static void ReduceKeys(const vector<float>& samples, unsigned int width,
+                           bool normalize, float tolerance, vector<unsigned int>& keys);
+    unsigned int FindKey(const Track& t, float frame);
+    static void EncodeRotation(const float q[4], unsigned char* dest);
+    static void DecodeRotation(const unsigned char* src, float q[4]);
+};
+
+} // NS Resources
+} // NS OpenEngine
+
+#endif // _ANIMATION_CLIP_H_
@@ -0,0 +1,412 @@
+// Caches shared between Collada resources imported together.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Resources/ColladaImportContext.h>
+
+#include <Resources/ResourceManager.h>
+#include <Geometry/Face.h>
+#include <Geometry/FaceSet.h>
+#include <Logging/Logger.h>
+
+#include <dae.h>
+
+#include <cstring>
+
+namespace OpenEngine {
+namespace Resources {
+
+using namespace OpenEngine::Logging;
+
+/**
+ * Context constructor.
+ * Creating the first database initializes the global DOM data, so
+ * it is done here on the calling thread.
+ */
+ColladaImportContext::ColladaImportContext()
+    : dae(new DAE()), sharedMaterials(0), sharedTextures(0),
+      sharedGeometries(0), faces(0), dedup(false), duplicates(0),
+      collisions(0), savedBytes(0) {}
+
+/**
+ * Context destructor.
+ * Shared materials, textures, faces and tangents stay alive in the
+ * resources using them.
+ */
+ColladaImportContext::~ColladaImportContext() {
+    for (map<string, SharedGeometry>::iterator itr = geometries.begin();
+         itr != geometries.end(); itr++)
+        delete itr->second.fs;
+    for (multimap<unsigned int, SharedGeometry>::iterator itr = meshes.begin();
+         itr != meshes.end(); itr++)
+        delete itr->second.fs;
+    delete dae;
+}
+
+// Helper function to create a face set sharing the faces of another.
+static FaceSet* CloneFaceSet(FaceSet* src) {
+    FaceSet* fs = new FaceSet();
+    for (FaceList::iterator itr = src->begin(); itr != src->end(); itr++)
+        fs->Add(*itr);
+    return fs;
+}
+
+/**
+ * Create a Collada database for a resource.
+ */
+DAE* ColladaImportContext::CreateDatabase() {
+    domLock.Lock();
+    DAE* d = new DAE();
+    domLock.Unlock();
+    return d;
+}
+
+/**
+ * Parse a Collada file into a database. Only one file is parsed at a
+ * time, as parsing fills the global DOM string table.
+ *
+ * @return The DAE error code of the load.
+ */
+int ColladaImportContext::LoadDatabase(DAE* d, const string& file) {
+    domLock.Lock();
+    int err;
+    try {
+        err = d->load(file.data());
+    }
+    catch (...) {
+        domLock.Unlock();
+        throw;
+    }
+    domLock.Unlock();
+    return err;
+}
+
+void ColladaImportContext::DestroyDatabase(DAE* d) {
+    domLock.Lock();
+    delete d;
+    domLock.Unlock();
+}
+
+/**
+ * Share a material by key.
+ *
+ * @param key Description of all material properties and textures.
+ * @param m Newly read material.
+ * @return The first material added with the key.
+ */
+MaterialPtr ColladaImportContext::ShareMaterial(const string& key, MaterialPtr m) {
+    lock.Lock();
+    map<string, MaterialPtr>::iterator itr = materials.find(key);
+    if (itr != materials.end()) {
+        m = itr->second;
+        sharedMaterials++;
+    }
+    else
+        materials[key] = m;
+    lock.Unlock();
+    return m;
+}
+
+/**
+ * Load a texture relative to a directory, or get the texture
+ * loaded earlier for the same file.
+ */
+ITexture2DPtr ColladaImportContext::LoadTexture(const string& dir, const string& uri) {
+    string key = dir + "/" + uri;
+    lock.Lock();
+    ITexture2DPtr tex;
+    map<string, ITexture2DPtr>::iterator itr = textures.find(key);
+    if (itr != textures.end()) {
+        tex = itr->second;
+        sharedTextures++;
+    }
+    else {
+        // the resource manager is not thread safe. The file is given
+        // by its full path, as a search path shared by all documents
+        // could resolve the uri to a file next to another document.
+        tex = ResourceManager<ITexture2D>::Create(key);
+        textures[key] = tex;
+    }
+    lock.Unlock();
+    return tex;
+}
+
+/**
+ * Look up a geometry that has already been loaded.
+ *
+ * @param key Document and id of the geometry element.
+ * @param tangents Set to the tangents of the geometry, or empty if it
+ *                 has none.
+ * @return A new face set sharing the faces of the geometry, owned by
+ *         the caller, or NULL if not found.
+ */
+FaceSet* ColladaImportContext::FindGeometry(const string& key, TangentListPtr& tangents) {
+    FaceSet* fs = NULL;
+    tangents.reset();
+    lock.Lock();
+    map<string, SharedGeometry>::iterator itr = geometries.find(key);
+    if (itr != geometries.end()) {
+        fs = CloneFaceSet(itr->second.fs);
+        tangents = itr->second.tangents;
+        sharedGeometries++;
+    }
+    lock.Unlock();
+    return fs;
+}
+
+/**
+ * Make a completely loaded geometry available to other resources.
+ * The first geometry added with a key wins. The context keeps a face
+ * set of its own, the caller keeps ownership of fs.
+ */
+void ColladaImportContext::AddGeometry(const string& key, FaceSet* fs, TangentListPtr tangents) {
+    lock.Lock();
+    if (geometries.find(key) == geometries.end()) {
+        SharedGeometry sg;
+        sg.fs = CloneFaceSet(fs);
+        sg.tangents = tangents;
+        geometries[key] = sg;
+        faces += fs->Size();
+    }
+    lock.Unlock();
+}
+
+/**
+ * Enable or disable content based deduplication of meshes.
+ * Disabled by default.
+ */
+void ColladaImportContext::SetDeduplication(bool enable) {
+    lock.Lock();
+    dedup = enable;
+    lock.Unlock();
+}
+
+bool ColladaImportContext::GetDeduplication() {
+    lock.Lock();
+    bool enabled = dedup;
+    lock.Unlock();
+    return enabled;
+}
+
+// Helper function to add the bits of the components of a vector to
+// an FNV-1a hash. Values that compare as equal must hash the same, so
+// -0 is hashed as 0 and all NaNs as one NaN.
+template <unsigned int N>
+static void HashVector(unsigned int& h, const Vector<N,float>& v) {
+    for (unsigned int i = 0; i < N; i++) {
+        float f = v[i];
+        unsigned int bits;
+        if (f == 0.0f)
+            bits = 0;
+        else if (f != f)
+            bits = 0x7FC00000;
+        else
+            memcpy(&bits, &f, sizeof(bits));
+        for (unsigned int b = 0; b < 4; b++) {
+            h ^= (bits >> (b * 8)) & 0xFF;
+            h *= 16777619u;
+        }
+    }
+}
+
+/**
+ * Hash the decoded vertex data and material of all faces.
+ */
+unsigned int ColladaImportContext::Hash(FaceSet* fs) {
+    unsigned int h = 2166136261u;
+    for (FaceList::iterator itr = fs->begin(); itr != fs->end(); itr++) {
+        Face* f = (*itr).get();
+        for (int c = 0; c < 3; c++) {
+            HashVector(h, f->vert[c]);
+            HashVector(h, f->norm[c]);
+            HashVector(h, f->texc[c]);
+            HashVector(h, f->colr[c]);
+        }
+        Material* m = f->mat.get();
+        for (unsigned int b = 0; b < sizeof(m); b++) {
+            h ^= (unsigned int)(((size_t)m >> (b * 8)) & 0xFF);
+            h *= 16777619u;
+        }
+    }
+    return h;
+}
+
+// Helper function to compare the components of two vectors, where
+// NaNs are equal to each other.
+template <unsigned int N>
+static bool EqualVector(const Vector<N,float>& a, const Vector<N,float>& b) {
+    for (unsigned int i = 0; i < N; i++)
+        if (!(a[i] == b[i]) && !(a[i] != a[i] && b[i] != b[i]))
+            return false;
+    return true;
+}
+
+/**
+ * Compare two face sets face by face.
+ */
+bool ColladaImportContext::Equal(FaceSet* a, FaceSet* b) {
+    if (a->Size() != b->Size())
+        return false;
+    FaceList::iterator ia = a->begin(), ib = b->begin();
+    for (; ia != a->end(); ia++, ib++) {
+        Face* fa = (*ia).get();
+        Face* fb = (*ib).get();
+        if (fa->mat != fb->mat)
+            return false;
+        for (int c = 0; c < 3; c++)
+            if (!EqualVector(fa->vert[c], fb->vert[c]) || !EqualVector(fa->norm[c], fb->norm[c]) ||
+                !EqualVector(fa->texc[c], fb->texc[c]) || !EqualVector(fa->colr[c], fb->colr[c]))
+                return false;
+    }
+    return true;
+}
+
+/**
+ * Find a mesh identical to the given one. Meshes are identical when
+ * all faces have the same vertex data and material, in the same
+ * order. If none is found the mesh is remembered for later lookups.
+ *
+ * Materials are compared by identity, so identical materials should
+ * be shared first (which resources using the context do).
+ *
+ * @param fs Completely loaded mesh, the caller keeps ownership.
+ * @param tangents Tangents of fs. If an identical mesh is found and
+ *                 both meshes have tangents, it is set to the
+ *                 tangents of that mesh.
+ * @return A new face set sharing the faces of the identical mesh,
+ *         owned by the caller, or NULL if fs is the first of its kind.
+ */
+FaceSet* ColladaImportContext::Deduplicate(FaceSet* fs, TangentListPtr& tangents) {
+    unsigned int h = Hash(fs);
+    lock.Lock();
+    SharedGeometry* found = NULL;
+    pair<multimap<unsigned int, SharedGeometry>::iterator,
+         multimap<unsigned int, SharedGeometry>::iterator> range = meshes.equal_range(h);
+    for (multimap<unsigned int, SharedGeometry>::iterator itr = range.first;
+         itr != range.second && found == NULL; itr++)
+        if (Equal(itr->second.fs, fs))
+            found = &itr->second;
+    FaceSet* dup = NULL;
+    if (found == NULL) {
+        // a new mesh with the hash of another mesh
+        if (range.first != range.second)
+            collisions++;
+        SharedGeometry sg;
+        sg.fs = CloneFaceSet(fs);
+        sg.tangents = tangents;
+        meshes.insert(make_pair(h, sg));
+    }
+    else {
+        dup = CloneFaceSet(found->fs);
+        // the first mesh may have been loaded without tangents
+        if (found->tangents.get() == NULL)
+            found->tangents = tangents;
+        else if (tangents.get() != NULL) {
+            savedBytes += tangents->size() * sizeof(FaceTangents) + sizeof(TangentList);
+            tangents = found->tangents;
+        }
+        duplicates++;
+        savedBytes += (unsigned long long)fs->Size() * (sizeof(Face) + sizeof(FacePtr))
+            + sizeof(FaceSet);
+    }
+    lock.Unlock();
+    return dup;
+}
+
+/**
+ * Number of distinct materials.
+ */
+unsigned int ColladaImportContext::GetMaterialCount() {
+    lock.Lock();
+    unsigned int n = materials.size();
+    lock.Unlock();
+    return n;
+}
+
+/**
+ * Number of materials replaced by an existing one.
+ */
+unsigned int ColladaImportContext::GetSharedMaterialCount() {
+    lock.Lock();
+    unsigned int n = sharedMaterials;
+    lock.Unlock();
+    return n;
+}
+
+unsigned int ColladaImportContext::GetTextureCount() {
+    lock.Lock();
+    unsigned int n = textures.size();
+    lock.Unlock();
+    return n;
+}
+
+unsigned int ColladaImportContext::GetSharedTextureCount() {
+    lock.Lock();
+    unsigned int n = sharedTextures;
+    lock.Unlock();
+    return n;
+}
+
+unsigned int ColladaImportContext::GetGeometryCount() {
+    lock.Lock();
+    unsigned int n = geometries.size();
+    lock.Unlock();
+    return n;
+}
+
+unsigned int ColladaImportContext::GetSharedGeometryCount() {
+    lock.Lock();
+    unsigned int n = sharedGeometries;
+    lock.Unlock();
+    return n;
+}
+
+/**
+ * Number of faces in all distinct geometries.
+ */
+unsigned int ColladaImportContext::GetFaceCount() {
+    lock.Lock();
+    unsigned int n = faces;
+    lock.Unlock();
+    return n;
+}
+
+/**
+ * Number of meshes replaced by an identical mesh.
+ */
+unsigned int ColladaImportContext::GetDuplicateCount() {
+    lock.Lock();
+    unsigned int n = duplicates;
+    lock.Unlock();
+    return n;
+}
+
+/**
+ * Number of distinct meshes that got the hash of another distinct
+ * mesh.
+ */
+unsigned int ColladaImportContext::GetCollisionCount() {
+    lock.Lock();
+    unsigned int n = collisions;
+    lock.Unlock();
+    return n;
+}
+
+/**
+ * Approximate number of bytes freed by deduplication, counting the
+ * faces and tangents of the replaced meshes.
+ */
+unsigned long long ColladaImportContext::GetSavedBytes() {
+    lock.Lock();
+    unsigned long long n = savedBytes;
+    lock.Unlock();
+    return n;
+}
+
+} // NS Resources
+} // NS OpenEngine
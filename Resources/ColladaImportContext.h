@@ -0,0 +1,116 @@
+// Caches shared between Collada resources imported together.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _COLLADA_IMPORT_CONTEXT_H_
+#define _COLLADA_IMPORT_CONTEXT_H_
+
+#include <Resources/ITexture2D.h>
+#include <Resources/TangentSpaceGenerator.h>
+#include <Geometry/Material.h>
+#include <Core/Mutex.h>
+
+#include <string>
+#include <map>
+
+class DAE;
+
+namespace OpenEngine {
+namespace Resources {
+
+using OpenEngine::Core::Mutex;
+using namespace OpenEngine::Geometry;
+using namespace std;
+
+/**
+ * Material, texture and geometry caches shared by a number of
+ * Collada resources, possibly loading on different threads.
+ *
+ * Materials are shared when their properties and textures match,
+ * textures when they resolve to the same file and geometries when
+ * they come from the same element of the same document. The context
+ * also keeps the global Collada DOM data alive while resources create
+ * and destroy their databases. The DOM interns all names in a process
+ * wide string table that is not thread safe, so the context lets only
+ * one database be created, parsed or destroyed at a time. The rest of
+ * the loading runs in parallel.
+ *
+ * Optionally, meshes with identical faces and materials are
+ * deduplicated regardless of their id and document. Meshes are found
+ * by a hash of their face data and compared in full before they are
+ * shared.
+ *
+ * The context keeps face sets of its own for the shared meshes, which
+ * share the faces with the face sets of the resources. Resources get
+ * new face sets from it, so unloading a resource never affects the
+ * context or other resources.
+ *
+ * All methods are thread safe. The context must outlive the
+ * resources using it.
+ *
+ * @class ColladaImportContext ColladaImportContext.h "ColladaImportContext.h"
+ */
+class ColladaImportContext {
+public:
+    ColladaImportContext();
+    virtual ~ColladaImportContext();
+
+    DAE* CreateDatabase();
+    int LoadDatabase(DAE* dae, const string& file);
+    void DestroyDatabase(DAE* dae);
+
+    MaterialPtr ShareMaterial(const string& key, MaterialPtr m);
+    ITexture2DPtr LoadTexture(const string& dir, const string& uri);
+    FaceSet* FindGeometry(const string& key, TangentListPtr& tangents);
+    void AddGeometry(const string& key, FaceSet* fs, TangentListPtr tangents);
+
+    void SetDeduplication(bool enable);
+    bool GetDeduplication();
+    FaceSet* Deduplicate(FaceSet* fs, TangentListPtr& tangents);
+
+    unsigned int GetMaterialCount();
+    unsigned int GetSharedMaterialCount();
+    unsigned int GetTextureCount();
+    unsigned int GetSharedTextureCount();
+    unsigned int GetGeometryCount();
+    unsigned int GetSharedGeometryCount();
+    unsigned int GetFaceCount();
+    unsigned int GetDuplicateCount();
+    unsigned int GetCollisionCount();
+    unsigned long long GetSavedBytes();
+
+private:
+    struct SharedGeometry {
+        FaceSet* fs;                  //!< owned by the context
+        TangentListPtr tangents;      //!< empty if none
+    };
+
+    Mutex domLock;                    //!< guards the global DOM data
+    DAE* dae;                         //!< keeps the DOM meta data alive
+
+    Mutex lock;                       //!< guards everything below
+
+    map<string, MaterialPtr> materials;
+    map<string, ITexture2DPtr> textures;
+    map<string, SharedGeometry> geometries;
+    unsigned int sharedMaterials, sharedTextures, sharedGeometries;
+    unsigned int faces;               //!< faces in the shared geometries
+
+    bool dedup;
+    multimap<unsigned int, SharedGeometry> meshes; //!< distinct meshes by content hash
+    unsigned int duplicates, collisions;
+    unsigned long long savedBytes;
+
+    static unsigned int Hash(FaceSet* fs);
+    static bool Equal(FaceSet* a, FaceSet* b);
+};
+
+} // NS Resources
+} // NS OpenEngine
+
+#endif // _COLLADA_IMPORT_CONTEXT_H_
@@ -0,0 +1,169 @@
+// Batch import of Collada files.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Resources/ColladaImporter.h>
+
+#include <Resources/ColladaResource.h>
+#include <Resources/ColladaJobQueue.h>
+#include <Core/Exceptions.h>
+#include <Logging/Logger.h>
+
+namespace OpenEngine {
+namespace Resources {
+
+using namespace OpenEngine::Logging;
+
+/**
+ * Job loading a single file.
+ */
+class ColladaImporter::ImportJob : public ColladaJobQueue::Job {
+private:
+    ColladaImporter& importer;
+    ColladaImportResult& result;
+public:
+    ImportJob(ColladaImporter& importer, ColladaImportResult& result)
+        : importer(importer), result(result) {}
+    void Execute() {
+        ColladaResource* r = new ColladaResource(result.file);
+        importer.Configure(r);
+        // the logger is not thread safe, messages are logged by Import()
+        r->SetMessageQueue(&result.messages);
+        try {
+            r->Load();
+            r->SetMessageQueue(NULL);
+            result.resource = IModelResourcePtr(r);
+        }
+        catch (Exception e) {
+            result.error = e.what();
+            delete r;
+        }
+        catch (...) {
+            // anything else must not reach the worker thread either
+            result.error = "Unknown error while loading.";
+            delete r;
+        }
+    }
+};
+
+/**
+ * Importer constructor.
+ * Defaults to four threads with tangent generation and without
+ * batching, like a single resource.
+ */
+ColladaImporter::ColladaImporter()
+    : context(new ColladaImportContext()), threads(4),
+      genTangents(true), batching(false) {
+    stats.files = stats.loaded = stats.failed = 0;
+}
+
+ColladaImporter::~ColladaImporter() {
+    delete context;
+}
+
+/**
+ * Set the number of files loaded at the same time.
+ */
+void ColladaImporter::SetThreadCount(unsigned int threads) {
+    this->threads = threads > 0 ? threads : 1;
+}
+
+void ColladaImporter::SetTangentGeneration(bool enable) {
+    genTangents = enable;
+}
+
+void ColladaImporter::SetBatching(bool enable) {
+    batching = enable;
+}
+
+/**
+ * Enable or disable sharing of identical meshes across files.
+ * @see ColladaImportContext::Deduplicate
+ */
+void ColladaImporter::SetDeduplication(bool enable) {
+    context->SetDeduplication(enable);
+}
+
+/**
+ * Import a list of files.
+ * Errors do not stop the import, they are reported in the result of
+ * the failing file. The log messages of each file are written to the
+ * logger in file order once all files are loaded.
+ *
+ * @param files Collada files to load.
+ * @return One result per file, in the order of the files.
+ */
+vector<ColladaImportResult> ColladaImporter::Import(const vector<string>& files) {
+    vector<ColladaImportResult> results(files.size());
+    ColladaJobQueue queue;
+    for (unsigned int i = 0; i < files.size(); i++) {
+        results[i].file = files[i];
+        queue.Add(new ImportJob(*this, results[i]));
+    }
+    queue.Run(threads);
+
+    unsigned int failed = 0;
+    for (unsigned int i = 0; i < results.size(); i++) {
+        for (unsigned int m = 0; m < results[i].messages.size(); m++)
+            ColladaLog::Write(results[i].messages[m]);
+        if (results[i].error.empty())
+            continue;
+        logger.warning << "Failed to import " << results[i].file << ": "
+                       << results[i].error << logger.end;
+        failed++;
+    }
+    stats.files += files.size();
+    stats.loaded += files.size() - failed;
+    stats.failed += failed;
+
+    logger.info << "Imported " << files.size() - failed << " of " << files.size()
+                << " Collada files." << logger.end;
+    if (context->GetDeduplication())
+        logger.info << "Deduplication shared " << context->GetDuplicateCount()
+                    << " meshes, saving about " << context->GetSavedBytes() / 1024
+                    << " KB." << logger.end;
+    return results;
+}
+
+/**
+ * Get the statistics of all imports done by this importer.
+ */
+ColladaImportStats ColladaImporter::GetStats() {
+    ColladaImportStats s = stats;
+    s.faces = context->GetFaceCount();
+    s.materials = context->GetMaterialCount();
+    s.sharedMaterials = context->GetSharedMaterialCount();
+    s.textures = context->GetTextureCount();
+    s.sharedTextures = context->GetSharedTextureCount();
+    s.geometries = context->GetGeometryCount();
+    s.sharedGeometries = context->GetSharedGeometryCount();
+    s.duplicateGeometries = context->GetDuplicateCount();
+    s.hashCollisions = context->GetCollisionCount();
+    s.savedBytes = context->GetSavedBytes();
+    return s;
+}
+
+ColladaImportContext* ColladaImporter::GetContext() {
+    return context;
+}
+
+/**
+ * Set up a resource before it is loaded. Subclasses can override
+ * this to change further resource settings, but should call the
+ * base implementation.
+ */
+void ColladaImporter::Configure(ColladaResource* resource) {
+    resource->SetImportContext(context);
+    // the files are already spread across the threads
+    resource->SetThreadCount(1);
+    resource->SetTangentGeneration(genTangents);
+    resource->SetBatching(batching);
+}
+
+} // NS Resources
+} // NS OpenEngine
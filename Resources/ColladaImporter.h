@@ -0,0 +1,93 @@
+// Batch import of Collada files.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _COLLADA_IMPORTER_H_
+#define _COLLADA_IMPORTER_H_
+
+#include <Resources/IModelResource.h>
+#include <Resources/ColladaImportContext.h>
+#include <Resources/ColladaLog.h>
+
+#include <string>
+#include <vector>
+
+namespace OpenEngine {
+namespace Resources {
+
+using namespace std;
+
+class ColladaResource;
+
+//! Result of importing a single file.
+struct ColladaImportResult {
+    string file;
+    IModelResourcePtr resource;       //!< the loaded ColladaResource, empty on failure
+    string error;                     //!< empty on success
+    vector<ColladaMessage> messages;  //!< log messages of the file, already logged by Import()
+};
+
+//! Aggregate statistics of a batch import.
+struct ColladaImportStats {
+    unsigned int files, loaded, failed;
+    unsigned int faces;               //!< faces in distinct geometries
+    unsigned int materials, sharedMaterials;
+    unsigned int textures, sharedTextures;
+    unsigned int geometries, sharedGeometries;
+    unsigned int duplicateGeometries; //!< meshes replaced by identical meshes
+    unsigned int hashCollisions;
+    unsigned long long savedBytes;    //!< approximate memory saved by deduplication
+};
+
+/**
+ * Imports many Collada files at once.
+ *
+ * The files are loaded concurrently, one file per worker thread, and
+ * all resources share one import context so matching materials,
+ * textures and geometries are only kept once. The Collada DOM is not
+ * thread safe, so the files are parsed one at a time; reading the
+ * parsed documents, tangent generation and animation baking run in
+ * parallel. Resources are fully
+ * loaded when Import() returns and their Collada documents have been
+ * released.
+ *
+ * The importer owns the import context and must outlive the imported
+ * resources.
+ *
+ * @class ColladaImporter ColladaImporter.h "ColladaImporter.h"
+ */
+class ColladaImporter {
+public:
+    ColladaImporter();
+    virtual ~ColladaImporter();
+
+    void SetThreadCount(unsigned int threads);
+    void SetTangentGeneration(bool enable);
+    void SetBatching(bool enable);
+    void SetDeduplication(bool enable);
+
+    vector<ColladaImportResult> Import(const vector<string>& files);
+    ColladaImportStats GetStats();
+    ColladaImportContext* GetContext();
+
+protected:
+    virtual void Configure(ColladaResource* resource);
+
+private:
+    class ImportJob;
+
+    ColladaImportContext* context;
+    unsigned int threads;
+    bool genTangents, batching;
+    ColladaImportStats stats;
+};
+
+} // NS Resources
+} // NS OpenEngine
+
+#endif // _COLLADA_IMPORTER_H_
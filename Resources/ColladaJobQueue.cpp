@@ -0,0 +1,119 @@
+// Collada import job queue.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Resources/ColladaJobQueue.h>
+
+#include <Core/Exceptions.h>
+#include <Core/Thread.h>
+#include <Logging/Logger.h>
+
+namespace OpenEngine {
+namespace Resources {
+
+using namespace OpenEngine::Logging;
+using OpenEngine::Core::Thread;
+
+/**
+ * Worker thread pulling jobs from the queue until it is empty.
+ */
+class ColladaJobQueue::Worker : public Thread {
+private:
+    ColladaJobQueue& queue;
+public:
+    Worker(ColladaJobQueue& queue) : queue(queue) {}
+    void Run() {
+        for (Job* job = queue.Next(); job != NULL; job = queue.Next()) {
+            try {
+                job->Execute();
+            }
+            catch (Exception e) {
+                queue.Fail(e.what());
+            }
+        }
+    }
+};
+
+ColladaJobQueue::ColladaJobQueue() : next(0) {}
+
+ColladaJobQueue::~ColladaJobQueue() {
+    Clear();
+}
+
+/**
+ * Add a job to the queue. The queue takes ownership of the job.
+ */
+void ColladaJobQueue::Add(Job* job) {
+    jobs.push_back(job);
+}
+
+/**
+ * Number of jobs waiting to be run.
+ */
+unsigned int ColladaJobQueue::Size() {
+    return jobs.size();
+}
+
+/**
+ * Execute all queued jobs and wait for them to finish.
+ * With a thread count of one (or a single job) everything is run on
+ * the calling thread. All jobs are deleted afterwards, and jobs that
+ * caused an exception are logged from the calling thread.
+ *
+ * @param threads Maximum number of worker threads.
+ */
+void ColladaJobQueue::Run(unsigned int threads) {
+    next = 0;
+    if (threads > jobs.size())
+        threads = jobs.size();
+
+    if (threads <= 1) {
+        Worker w(*this);
+        w.Run();
+    } else {
+        vector<Worker*> workers;
+        for (unsigned int i = 0; i < threads; i++) {
+            Worker* w = new Worker(*this);
+            workers.push_back(w);
+            w->Start();
+        }
+        for (unsigned int i = 0; i < threads; i++) {
+            workers[i]->Wait();
+            delete workers[i];
+        }
+    }
+    for (unsigned int i = 0; i < errors.size(); i++)
+        logger.warning << "Import job caused an exception: " << errors[i] << logger.end;
+    errors.clear();
+    Clear();
+}
+
+ColladaJobQueue::Job* ColladaJobQueue::Next() {
+    Job* job = NULL;
+    lock.Lock();
+    if (next < jobs.size())
+        job = jobs[next++];
+    lock.Unlock();
+    return job;
+}
+
+void ColladaJobQueue::Fail(const string& error) {
+    lock.Lock();
+    errors.push_back(error);
+    lock.Unlock();
+}
+
+void ColladaJobQueue::Clear() {
+    for (vector<Job*>::iterator itr = jobs.begin(); itr != jobs.end(); itr++)
+        delete *itr;
+    jobs.clear();
+    next = 0;
+}
+
+} // NS Resources
+} // NS OpenEngine
@@ -0,0 +1,68 @@
+// Collada import job queue.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _COLLADA_JOB_QUEUE_H_
+#define _COLLADA_JOB_QUEUE_H_
+
+#include <Core/Mutex.h>
+
+#include <string>
+#include <vector>
+
+namespace OpenEngine {
+namespace Resources {
+
+using OpenEngine::Core::Mutex;
+using namespace std;
+
+/**
+ * Simple job queue used to spread import work across threads.
+ *
+ * Jobs are added to the queue and executed by a number of worker
+ * threads when Run() is called. Run() returns when all jobs have
+ * finished, so it also acts as a barrier between import stages.
+ *
+ * @class ColladaJobQueue ColladaJobQueue.h "ColladaJobQueue.h"
+ */
+class ColladaJobQueue {
+public:
+    /**
+     * A unit of work. Jobs must not touch data owned by other jobs
+     * in the same queue.
+     */
+    class Job {
+    public:
+        virtual ~Job() {}
+        virtual void Execute() = 0;
+    };
+
+    ColladaJobQueue();
+    virtual ~ColladaJobQueue();
+
+    void Add(Job* job);
+    void Run(unsigned int threads);
+    unsigned int Size();
+
+private:
+    class Worker;
+
+    vector<Job*> jobs;  //!< pending jobs, owned by the queue
+    unsigned int next;  //!< index of the next job to hand out
+    Mutex lock;         //!< guards next and errors
+    vector<string> errors; //!< exceptions of failed jobs, logged by Run()
+
+    Job* Next();
+    void Fail(const string& error);
+    void Clear();
+};
+
+} // NS Resources
+} // NS OpenEngine
+
+#endif // _COLLADA_JOB_QUEUE_H_
@@ -0,0 +1,62 @@
+// Log messages of a Collada resource.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Resources/ColladaLog.h>
+
+#include <Logging/Logger.h>
+
+namespace OpenEngine {
+namespace Resources {
+
+using namespace OpenEngine::Logging;
+
+ColladaLog::Stream::Stream(ColladaLog& log, bool warning)
+    : log(log), warning(warning) {}
+
+ColladaLog::Stream& ColladaLog::Stream::operator<<(const End& end) {
+    log.Add(warning, text.str());
+    text.str("");
+    return *this;
+}
+
+ColladaLog::ColladaLog()
+    : info(*this, false), warning(*this, true), queue(NULL) {}
+
+/**
+ * Keep messages in a queue instead of writing them to the logger.
+ *
+ * @param queue List the messages are appended to, NULL to write
+ *              messages to the logger again.
+ */
+void ColladaLog::SetQueue(vector<ColladaMessage>* queue) {
+    this->queue = queue;
+}
+
+/**
+ * Write a queued message to the engine logger.
+ */
+void ColladaLog::Write(const ColladaMessage& message) {
+    if (message.warning)
+        logger.warning << message.text << logger.end;
+    else
+        logger.info << message.text << logger.end;
+}
+
+void ColladaLog::Add(bool warning, const string& text) {
+    ColladaMessage message;
+    message.warning = warning;
+    message.text = text;
+    if (queue != NULL)
+        queue->push_back(message);
+    else
+        Write(message);
+}
+
+} // NS Resources
+} // NS OpenEngine
@@ -0,0 +1,80 @@
+// Log messages of a Collada resource.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _COLLADA_LOG_H_
+#define _COLLADA_LOG_H_
+
+#include <string>
+#include <vector>
+#include <sstream>
+
+namespace OpenEngine {
+namespace Resources {
+
+using namespace std;
+
+//! A log message kept for later.
+struct ColladaMessage {
+    bool warning;                     //!< warning or info message
+    string text;
+};
+
+/**
+ * Log of a single Collada resource, used like the engine logger:
+ * @code
+ * log.warning << "Invalid geometry url." << log.end;
+ * @endcode
+ *
+ * Messages are written to the engine logger unless a message queue
+ * is set. Resources loading on worker threads queue their messages
+ * instead, and whoever started the threads writes them to the logger
+ * once the threads are done.
+ *
+ * @class ColladaLog ColladaLog.h "ColladaLog.h"
+ */
+class ColladaLog {
+public:
+    //! Marks the end of a message.
+    struct End {};
+
+    //! Collects the parts of one message.
+    class Stream {
+    private:
+        ColladaLog& log;
+        bool warning;
+        ostringstream text;
+    public:
+        Stream(ColladaLog& log, bool warning);
+        template <class T> Stream& operator<<(const T& value) {
+            text << value;
+            return *this;
+        }
+        Stream& operator<<(const End& end);
+    };
+
+    Stream info, warning;
+    End end;
+
+    ColladaLog();
+    void SetQueue(vector<ColladaMessage>* queue);
+
+    static void Write(const ColladaMessage& message);
+
+private:
+    vector<ColladaMessage>* queue;    //!< NULL writes to the logger
+
+    ColladaLog(const ColladaLog&);
+    ColladaLog& operator=(const ColladaLog&);
+    void Add(bool warning, const string& text);
+};
+
+} // NS Resources
+} // NS OpenEngine
+
+#endif // _COLLADA_LOG_H_
@@ -0,0 +1,53 @@
+// Small vector helpers shared by the Collada import stages.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _COLLADA_MATH_H_
+#define _COLLADA_MATH_H_
+
+#include <Math/Vector.h>
+
+#include <cmath>
+
+namespace OpenEngine {
+namespace Resources {
+namespace ColladaMath {
+
+using OpenEngine::Math::Vector;
+
+// These work directly on the components to avoid depending on the
+// semantics of the Vector operators.
+
+inline float Dot(const Vector<3,float>& a, const Vector<3,float>& b) {
+    return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+inline Vector<3,float> Cross(const Vector<3,float>& a, const Vector<3,float>& b) {
+    return Vector<3,float>(a[1]*b[2] - a[2]*b[1],
+                           a[2]*b[0] - a[0]*b[2],
+                           a[0]*b[1] - a[1]*b[0]);
+}
+
+/**
+ * Normalize v in place.
+ *
+ * @return false (leaving v untouched) if v is too short.
+ */
+inline bool Normalize(Vector<3,float>& v) {
+    float len = std::sqrt(Dot(v,v));
+    if (len < 1e-12f)
+        return false;
+    v = Vector<3,float>(v[0]/len, v[1]/len, v[2]/len);
+    return true;
+}
+
+} // NS ColladaMath
+} // NS Resources
+} // NS OpenEngine
+
+#endif // _COLLADA_MATH_H_
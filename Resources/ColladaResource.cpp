@@ -13,13 +13,16 @@
 #include <Resources/ITexture2D.h>
 #include <Resources/ResourceManager.h>
 #include <Resources/File.h>
-#include <Logging/Logger.h>
 #include <Utils/Convert.h>
 #include <Geometry/FaceSet.h>
 #include <Scene/GeometryNode.h>
 #include <Scene/ISceneNode.h>
 #include <Scene/TransformationNode.h>
 
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
 
 
 
@@ -28,7 +31,6 @@
 namespace OpenEngine {
 namespace Resources {
 
-using namespace OpenEngine::Logging;
 using OpenEngine::Utils::Convert;
 using namespace OpenEngine::Geometry;
 
@@ -38,7 +40,7 @@ using namespace OpenEngine::Geometry;
 /**
  * Get the file extension for Collada files.
  */
-ColladaPlugin::ColladaPlugin() {
+ColladaPlugin::ColladaPlugin() : context(NULL) {
     this->AddExtension("dae");
 }
 
@@ -46,7 +48,23 @@ ColladaPlugin::ColladaPlugin() {
  * Create a Collada resource.
  */
 IModelResourcePtr ColladaPlugin::CreateResource(string file) {
-    return IModelResourcePtr(new ColladaResource(file));
+    ColladaResource* r = new ColladaResource(file);
+    if (context != NULL)
+        r->SetImportContext(context);
+    return IModelResourcePtr(r);
+}
+
+/**
+ * Share materials, textures and geometries between all resources
+ * created by the plug-in from now on, including the deduplication of
+ * identical meshes if it is enabled on the context. The context is
+ * not owned by the plug-in and must outlive the resources.
+ *
+ * @param context Shared caches, NULL to stop sharing.
+ * @see ColladaResource::SetImportContext
+ */
+void ColladaPlugin::SetImportContext(ColladaImportContext* context) {
+    this->context = context;
 }
 
 
@@ -55,27 +73,41 @@ IModelResourcePtr ColladaPlugin::CreateResource(string file) {
 /**
  * Resource constructor.
  */
-ColladaResource::ColladaResource(string file) : file(file), root(NULL), dae(NULL) {}
+ColladaResource::ColladaResource(string file)
+    : genTangents(true), creaseAngle(PI/3.0), threads(4), parallel(false),
+      generator(NULL), batcher(NULL),
+      skinFormat(SKIN_WEIGHTS_8), vertexIndices(NULL),
+      animRate(30.0), posTolerance(1e-3), rotTolerance(1e-4), baking(false), context(NULL),
+      file(file), root(NULL), dae(NULL), state(LOAD_IDLE), currentGeometry(NULL) {}
 
 /**
  * Resource destructor.
  */
 ColladaResource::~ColladaResource() {
     Unload();
+    if (batcher != NULL)
+        delete batcher;
 }
 
 void ColladaResource::ReadImage(domImage* img,
                                 MaterialPtr m) {
-    // we reset the resource path temporary to create the texture resource
     string resource_dir = File::Parent(this->file);
 
-	if (! DirectoryManager::IsInPath(resource_dir)) {
-        DirectoryManager::AppendPath(resource_dir);
-    }
-
     domImage::domInit_from* initFrom = img->getInit_from();
     if (initFrom != NULL) {
-        m->AddTexture(ResourceManager<ITexture2D>::Create(initFrom->getValue().getOriginalURI()));
+        string uri = initFrom->getValue().getOriginalURI();
+        // the context extends the resource path under its own lock
+        if (context != NULL) {
+            m->AddTexture(context->LoadTexture(resource_dir, uri));
+            textureKey += resource_dir + "/" + uri + ";";
+        }
+        else {
+            // we reset the resource path temporary to create the texture resource
+            if (! DirectoryManager::IsInPath(resource_dir)) {
+                DirectoryManager::AppendPath(resource_dir);
+            }
+            m->AddTexture(ResourceManager<ITexture2D>::Create(uri));
+        }
     }
 }
 
@@ -95,8 +127,8 @@ void ColladaResource::ReadTexture(domCommon_color_or_texture_type_complexType::d
     if (elm == NULL) {
         elm = params[tex->getTexture()];
         if (elm == NULL) {
-            logger.warning << "Invalid texture reference: " << 
-                tex->getTexture() << ". No texture Loaded." << logger.end;
+            log.warning << "Invalid texture reference: " << 
+                tex->getTexture() << ". No texture Loaded." << log.end;
             return;
         }
     }
@@ -132,7 +164,7 @@ MaterialPtr ColladaResource::LoadMaterial(domMaterial* dm) {
     // see if material has already been loaded.
 
     if (dm == NULL) {
-        logger.warning << "No material found. Fall back to default material." << logger.end;
+        log.warning << "No material found. Fall back to default material." << log.end;
         return MaterialPtr(new Material());
     } 
     
@@ -149,11 +181,60 @@ MaterialPtr ColladaResource::LoadMaterial(domMaterial* dm) {
     
 
     // read the effect into the material.
+    textureKey.clear();
     ReadEffect(dm->getInstance_effect(), m);
 
+    // use an equal material from another resource if there is one
+    if (context != NULL) {
+        m = context->ShareMaterial(MaterialKey(m), m);
+        materials[dm->getID()] = m;
+    }
+
     return m;
 }
 
+// Helper function to append the exact bits of a float to a key.
+// Printing the value would round it, and merge materials that only
+// differ in the last digits.
+static void AppendKey(string& key, float f) {
+    unsigned int bits;
+    memcpy(&bits, &f, sizeof(bits));
+    char hex[16];
+    sprintf(hex, "%08x,", bits);
+    key += hex;
+}
+
+// Helper function to append the components of a vector to a key.
+static void AppendKey(string& key, const Vector<4,float>& v) {
+    for (int i = 0; i < 4; i++)
+        AppendKey(key, v[i]);
+}
+
+/**
+* Helper function to describe the properties and textures of a
+* material, such that equal materials get the same key.
+*/
+string ColladaResource::MaterialKey(MaterialPtr m) {
+    string key;
+    AppendKey(key, m->diffuse);
+    AppendKey(key, m->ambient);
+    AppendKey(key, m->specular);
+    AppendKey(key, m->emission);
+    AppendKey(key, m->shininess);
+    key += ";" + textureKey;
+    return key;
+}
+
+/**
+* Helper function to build the import context key of a geometry.
+* Faces are rotated when reading Z-up files, so the axis is part of
+* the key.
+*/
+string ColladaResource::GeometryKey(domGeometry* geom) {
+    string key = geom->getDocumentURI()->getURI();
+    return key + "#" + geom->getID() + (yUp ? "" : "#Z_UP");
+}
+
 void ColladaResource::ReadColor(domCommon_color_or_texture_type_complexType* ct, 
                                 Vector<4,float>* dest) {
     if (ct != NULL && ct->getColor() != NULL) {
@@ -227,7 +308,7 @@ void ColladaResource::ReadEffect(domInstance_effect* eInst, MaterialPtr m) {
     // get the effect element pointed to by instance_effect
     domEffect* e = dynamic_cast<domEffect*>(eInst->getUrl().getElement().cast());
     if (e == NULL) {
-        logger.warning << "Could not resolve effect uri." << logger.end;
+        log.warning << "Could not resolve effect uri." << log.end;
         return;
     }
     
@@ -272,42 +353,815 @@ void ColladaResource::ReadEffect(domInstance_effect* eInst, MaterialPtr m) {
     }
 }
 
+// Helper function to create a face set sharing the faces of another.
+static FaceSet* CloneFaceSet(FaceSet* src) {
+    FaceSet* fs = new FaceSet();
+    for (FaceList::iterator itr = src->begin(); itr != src->end(); itr++)
+        fs->Add(*itr);
+    return fs;
+}
+
 /**
-* Helper function to load the geometry from a given domGeometry node
+* Helper function to create a geometry node for an instance_geometry.
 */
 GeometryNode* ColladaResource::LoadGeometry(domInstance_geometry* gInst) {
     domGeometry* geom = dynamic_cast<domGeometry*>(gInst->getUrl().getElement().cast());
     if (!geom) 
         return NULL;
 
-    FaceSet* fs = new FaceSet();
-    domMesh* mesh = geom->getMesh();
-    
-    // Display warnings if unsupported geometry types are defined
-    if (mesh->getLines_array().getCount() > 0)
-        logger.warning << "Unsupported geometry types found: Lines" << logger.end;
-    if (mesh->getLinestrips_array().getCount() > 0)
-        logger.warning << "Unsupported geometry types found: Linestrips" << logger.end;
-    if (mesh->getPolygons_array().getCount() > 0)
-        logger.warning << "Unsupported geometry types found: Polygons" << logger.end;
-    if (mesh->getPolylist_array().getCount() > 0)
-        logger.warning << "Unsupported geometry types found: Polylist" << logger.end;
-    if (mesh->getTrifans_array().getCount() > 0)
-        logger.warning << "Unsupported geometry types found: Trifans" << logger.end;
-    if (mesh->getTristrips_array().getCount() > 0)
-        logger.warning << "Unsupported geometry types found: Tristrips" << logger.end;
-
-
-    // read the triangle data into our face set.
-    domTriangles_Array trianglesArr = mesh->getTriangles_array();
-    for (unsigned int i = 0; i < trianglesArr.getCount(); i++) {
-        ReadTriangles(trianglesArr[i],fs); 
-    }   
+    map<domGeometry*, FaceSet*>::iterator itr = geometries.find(geom);
+    if (itr == geometries.end())
+        return NULL;
         
+    return CreateGeometryNode(itr->second);
+}
+
+/**
+* Helper function to create a geometry node for an instance of a
+* mesh. Geometry nodes own their face set, so every node gets its own
+* face set holding the faces of the mesh. The faces themselves and
+* the tangent list are shared by all instances.
+*/
+GeometryNode* ColladaResource::CreateGeometryNode(FaceSet* mesh) {
+    FaceSet* fs = CloneFaceSet(mesh);
+    map<FaceSet*, TangentListPtr>::iterator titr = tangents.find(mesh);
+    if (titr != tangents.end())
+        tangents[fs] = titr->second;
     return new GeometryNode(fs);
 }
 
-void ColladaResource::ReadTriangles(domTriangles* ts, FaceSet* fs) {
+// Helper function to convert a collada matrix (column vectors) at
+// offset in the array into the row vector form used by the engine.
+static Matrix<4,4,float> ReadMatrix(domListOfFloats& m, unsigned int offset) {
+    return Matrix<4,4,float>(m[offset+0], m[offset+4], m[offset+8],  m[offset+12],
+                             m[offset+1], m[offset+5], m[offset+9],  m[offset+13],
+                             m[offset+2], m[offset+6], m[offset+10], m[offset+14],
+                             m[offset+3], m[offset+7], m[offset+11], m[offset+15]);
+}
+
+// Helper function to find a node by sid in the subtree rooted at n.
+static domNode* FindNodeBySid(domNode* n, const string& sid) {
+    if (n->getSid() != NULL && sid == n->getSid())
+        return n;
+    domNode_Array childArr = n->getNode_array();
+    for (unsigned int i = 0; i < childArr.getCount(); i++) {
+        domNode* found = FindNodeBySid(childArr[i], sid);
+        if (found != NULL)
+            return found;
+    }
+    return NULL;
+}
+
+/**
+* Helper function to create a geometry node for a skinned
+* instance_controller. Every instance gets its own skin, as the
+* instances may bind different skeletons. The joints are resolved
+* once the node graph is done.
+*
+* @param cInst The controller instance.
+* @param path Instance path the controller is read in.
+*/
+GeometryNode* ColladaResource::LoadController(domInstance_controller* cInst, unsigned int path) {
+    domController* ctrl = dynamic_cast<domController*>(cInst->getUrl().getElement().cast());
+    if (!ctrl || ctrl->getID() == NULL)
+        return NULL;
+    domSkin* skin = ctrl->getSkin();
+    if (skin == NULL) {
+        log.warning << "Unsupported controller type in: " << ctrl->getID() << log.end;
+        return NULL;
+    }
+
+    domGeometry* geom = dynamic_cast<domGeometry*>(skin->getSource().getElement().cast());
+    if (!geom)
+        return NULL;
+    map<domGeometry*, FaceSet*>::iterator gitr = geometries.find(geom);
+    if (gitr == geometries.end())
+        return NULL;
+
+    PendingSkin ps;
+    Skin* sk = ReadSkin(skin, skinVertices[geom], ps.idRefs);
+    if (sk == NULL)
+        return NULL;
+    skins.push_back(sk);
+    ps.skin = sk;
+    ps.instance = cInst;
+    ps.path = path;
+    pendingSkins.push_back(ps);
+
+    GeometryNode* gn = CreateGeometryNode(gitr->second);
+    skinNodes[gn] = sk;
+
+    // skinned geometry is never static
+    if (batcher != NULL)
+        batcher->Exclude(gn);
+    return gn;
+}
+
+/**
+* Helper function to read a <skin> element into the compact skin
+* encoding.
+*
+* @param skin The skin element.
+* @param corners Mesh vertex of each face corner of the skinned mesh.
+* @param idRefs Set to true if the joints are referenced by id.
+*/
+Skin* ColladaResource::ReadSkin(domSkin* skin, const vector<unsigned int>& corners,
+                                bool& idRefs) {
+    domSkin::domJoints* joints = skin->getJoints();
+    domSkin::domVertex_weights* vw = skin->getVertex_weights();
+    if (joints == NULL || vw == NULL || vw->getVcount() == NULL || vw->getV() == NULL) {
+        log.warning << "Incomplete skin element." << log.end;
+        return NULL;
+    }
+
+    Skin* sk = new Skin(skinFormat);
+    idRefs = false;
+
+    if (skin->getBind_shape_matrix() != NULL) {
+        domFloat4x4 bsm = skin->getBind_shape_matrix()->getValue();
+        sk->bindShapeMatrix = ReadMatrix(bsm, 0);
+    }
+
+    // the mesh vertices have been rotated when y is not the up axis,
+    // undo the rotation in the bind shape so skinning ends up in the
+    // space of the joint nodes.
+    if (!yUp) {
+        Vector<3,float> r[3];
+        r[0] = rot.RotateVector(Vector<3,float>(1.0,0.0,0.0));
+        r[1] = rot.RotateVector(Vector<3,float>(0.0,1.0,0.0));
+        r[2] = rot.RotateVector(Vector<3,float>(0.0,0.0,1.0));
+        Matrix<4,4,float> unrotate(r[0][0], r[1][0], r[2][0], 0,
+                                   r[0][1], r[1][1], r[2][1], 0,
+                                   r[0][2], r[1][2], r[2][2], 0,
+                                   0,       0,       0,       1);
+        sk->bindShapeMatrix = unrotate * sk->bindShapeMatrix;
+    }
+
+    // joint names and inverse bind matrices
+    domInputLocal_Array jInputs = joints->getInput_array();
+    for (unsigned int i = 0; i < jInputs.getCount(); i++) {
+        domSource* src = dynamic_cast<domSource*>(jInputs[i]->getSource().getElement().cast());
+        if (src == NULL)
+            continue;
+
+        if (strcmp(jInputs[i]->getSemantic(), COMMON_PROFILE_INPUT_JOINT) == 0) {
+            if (src->getName_array() != NULL) {
+                domListOfNames names = src->getName_array()->getValue();
+                for (unsigned int k = 0; k < names.getCount(); k++)
+                    sk->jointNames.push_back(names[k]);
+            }
+            else if (src->getIDREF_array() != NULL) {
+                xsIDREFS refs = src->getIDREF_array()->getValue();
+                for (unsigned int k = 0; k < refs.getCount(); k++)
+                    sk->jointNames.push_back(refs[k].getID());
+                idRefs = true;
+            }
+        }
+        else if (strcmp(jInputs[i]->getSemantic(), COMMON_PROFILE_INPUT_INV_BIND_MATRIX) == 0) {
+            if (src->getFloat_array() == NULL)
+                continue;
+            domListOfFloats m = src->getFloat_array()->getValue();
+            for (unsigned int k = 0; k + 16 <= m.getCount(); k += 16)
+                sk->inverseBindMatrices.push_back(ReadMatrix(m, k));
+        }
+    }
+
+    if (sk->inverseBindMatrices.size() != sk->jointNames.size())
+        log.warning << "Skin has " << sk->jointNames.size() << " joints but "
+                    << sk->inverseBindMatrices.size() << " inverse bind matrices."
+                    << log.end;
+
+    // the influence lists
+    unsigned int inputs = 0, jointOffset = 0, weightOffset = 0;
+    vector<float> weights;
+    domInputLocalOffset_Array wInputs = vw->getInput_array();
+    for (unsigned int i = 0; i < wInputs.getCount(); i++) {
+        unsigned int offset = wInputs[i]->getOffset();
+        if (offset + 1 > inputs)
+            inputs = offset + 1;
+        if (strcmp(wInputs[i]->getSemantic(), COMMON_PROFILE_INPUT_JOINT) == 0)
+            jointOffset = offset;
+        else if (strcmp(wInputs[i]->getSemantic(), COMMON_PROFILE_INPUT_WEIGHT) == 0) {
+            weightOffset = offset;
+            domSource* src = dynamic_cast<domSource*>(wInputs[i]->getSource().getElement().cast());
+            if (src != NULL && src->getFloat_array() != NULL) {
+                domListOfFloats w = src->getFloat_array()->getValue();
+                for (unsigned int k = 0; k < w.getCount(); k++)
+                    weights.push_back(w[k]);
+            }
+        }
+    }
+
+    domListOfUInts vcountArr = vw->getVcount()->getValue();
+    vector<unsigned int> vcount(vcountArr.getCount());
+    for (unsigned int i = 0; i < vcountArr.getCount(); i++)
+        vcount[i] = vcountArr[i];
+
+    domListOfInts vArr = vw->getV()->getValue();
+    vector<int> v(vArr.getCount());
+    for (unsigned int i = 0; i < vArr.getCount(); i++)
+        v[i] = vArr[i];
+
+    if (sk->jointNames.size() > Skin::MAX_JOINTS)
+        log.warning << "Skin has " << sk->jointNames.size() << " joints, influences of joints above "
+                    << Skin::MAX_JOINTS << " are dropped." << log.end;
+    sk->Encode(vcount, v, inputs, jointOffset, weightOffset, weights, corners);
+    if (sk->GetDroppedInfluences() > 0)
+        log.warning << "Skin: dropped " << sk->GetDroppedInfluences()
+                    << " invalid influences." << log.end;
+    if (sk->GetTruncatedVertices() > 0)
+        log.info << "Skin: " << sk->GetTruncatedVertices() << " vertices had more than "
+                 << Skin::MAX_INFLUENCES << " influences." << log.end;
+    if (sk->GetUnboundVertices() > 0)
+        log.warning << "Skin: " << sk->GetUnboundVertices()
+                    << " vertices without influences were bound to the first joint." << log.end;
+    return sk;
+}
+
+/**
+* Helper function to resolve the joints of a skin to the scene nodes
+* created for them.
+*/
+void ColladaResource::ResolveJoints(PendingSkin& ps) {
+    Skin* sk = ps.skin;
+    sk->joints.assign(sk->jointNames.size(), NULL);
+
+    // the skeleton roots to search for sids
+    vector<domNode*> roots;
+    domInstance_controller::domSkeleton_Array skelArr = ps.instance->getSkeleton_array();
+    for (unsigned int i = 0; i < skelArr.getCount(); i++) {
+        domNode* n = dynamic_cast<domNode*>(skelArr[i]->getValue().getElement().cast());
+        if (n != NULL)
+            roots.push_back(n);
+    }
+
+    daeDatabase* db = dae->getDatabase();
+    int nodeCount = db->getElementCount(NULL, COLLADA_ELEMENT_NODE, NULL);
+
+    unsigned int missing = 0;
+    for (unsigned int i = 0; i < sk->jointNames.size(); i++) {
+        const string& name = sk->jointNames[i];
+        domNode* jn = NULL;
+
+        if (ps.idRefs) {
+            daeIDRef ref(name.c_str());
+            ref.setContainer(ps.instance);
+            jn = dynamic_cast<domNode*>(ref.getElement());
+        } else {
+            for (unsigned int r = 0; r < roots.size() && jn == NULL; r++)
+                jn = FindNodeBySid(roots[r], name);
+
+            // no skeleton given, search all nodes by sid and then id
+            for (int n = 0; n < nodeCount && jn == NULL; n++) {
+                domNode* dn = NULL;
+                db->getElement((daeElement**)&dn, n, NULL, COLLADA_ELEMENT_NODE, NULL);
+                if (dn != NULL && ((dn->getSid() != NULL && name == dn->getSid()) ||
+                                   (dn->getId() != NULL && name == dn->getId())))
+                    jn = dn;
+            }
+        }
+
+        if (jn != NULL)
+            sk->joints[i] = FindSceneNode(jn, ps.path);
+        if (sk->joints[i] == NULL)
+            missing++;
+    }
+
+    if (missing > 0)
+        log.warning << "Could not resolve " << missing << " of "
+                    << sk->jointNames.size() << " skin joints." << log.end;
+}
+
+/**
+* Helper function to find the scene node created for a node. A node
+* reached through several <instance_node> elements has a scene node
+* in each instance path, the one in the given path or the closest
+* enclosing path is preferred.
+*
+* @return The scene node or NULL if the node was never read.
+*/
+ISceneNode* ColladaResource::FindSceneNode(domNode* dn, unsigned int path) {
+    for (;;) {
+        map<pair<domNode*, unsigned int>, ISceneNode*>::iterator itr =
+            sceneNodes.find(make_pair(dn, path));
+        if (itr != sceneNodes.end())
+            return itr->second;
+        if (path == 0)
+            break;
+        path = pathParents[path];
+    }
+
+    // the node only exists in unrelated paths, use the first of them
+    map<pair<domNode*, unsigned int>, ISceneNode*>::iterator itr =
+        sceneNodes.lower_bound(make_pair(dn, 0u));
+    if (itr != sceneNodes.end() && itr->first.first == dn)
+        return itr->second;
+    return NULL;
+}
+
+// Helper function to read a float source, returns false if the
+// source has no float array.
+static bool ReadFloatSource(domSource* src, vector<float>& dest, unsigned int& stride) {
+    if (src == NULL || src->getFloat_array() == NULL)
+        return false;
+    domListOfFloats arr = src->getFloat_array()->getValue();
+    dest.resize(arr.getCount());
+    for (unsigned int i = 0; i < arr.getCount(); i++)
+        dest[i] = arr[i];
+    stride = 1;
+    if (src->getTechnique_common() != NULL &&
+        src->getTechnique_common()->getAccessor() != NULL)
+        stride = src->getTechnique_common()->getAccessor()->getStride();
+    if (stride == 0)
+        stride = 1;
+    return true;
+}
+
+// Helper function to build the bezier control points of a key from
+// its tangents, one (time, value) pair per component. Tangents are
+// given as (time, value) points or, by older exporters, as values
+// only, in which case the control points lie at a third of the
+// segment. Hermite tangents are the slope over the segment and
+// become control points a third of the tangent away from the key.
+//
+// @param side 1 for the out tangent, -1 for the in tangent.
+static void ReadControls(const vector<float>& tangents, unsigned int tanStride,
+                         const vector<float>& times, const vector<float>& values,
+                         unsigned int stride, unsigned int key, bool hermite,
+                         float side, float* dest) {
+    float t = times[key];
+    float third = 0.0;
+    if (side > 0.0f && key + 1 < times.size())
+        third = (times[key + 1] - t) / 3.0f;
+    else if (side < 0.0f && key > 0)
+        third = (t - times[key - 1]) / 3.0f;
+    bool points = tanStride == 2 * stride;
+    for (unsigned int i = 0; i < stride; i++) {
+        float v = values[key * stride + i];
+        float x = points ? tangents[key * tanStride + 2 * i] : 0.0f;
+        float y = points ? tangents[key * tanStride + 2 * i + 1] : tangents[key * tanStride + i];
+        if (hermite && points) {
+            dest[2 * i] = t + side * x / 3.0f;
+            dest[2 * i + 1] = v + side * y / 3.0f;
+        } else if (hermite) {
+            dest[2 * i] = t + side * third;
+            dest[2 * i + 1] = v + side * y / 3.0f;
+        } else {
+            dest[2 * i] = points ? x : t + side * third;
+            dest[2 * i + 1] = y;
+        }
+    }
+}
+
+// Helper function to evaluate a cubic bezier segment, given by four
+// (time, value) points, at time t. The curve parameter at t is found
+// by bisection, with the inner control points clamped to the segment
+// so there is a parameter for every time in it.
+static float EvaluateBezier(const float p0[2], const float p1[2],
+                            const float p2[2], const float p3[2], float t) {
+    float x1 = p1[0] < p0[0] ? p0[0] : (p1[0] > p3[0] ? p3[0] : p1[0]);
+    float x2 = p2[0] < p0[0] ? p0[0] : (p2[0] > p3[0] ? p3[0] : p2[0]);
+    float lo = 0.0, hi = 1.0;
+    for (int i = 0; i < 24; i++) {
+        float s = (lo + hi) * 0.5f, u = 1.0f - s;
+        float x = u*u*u*p0[0] + 3.0f*u*u*s*x1 + 3.0f*u*s*s*x2 + s*s*s*p3[0];
+        if (x < t)
+            lo = s;
+        else
+            hi = s;
+    }
+    float s = (lo + hi) * 0.5f, u = 1.0f - s;
+    return u*u*u*p0[1] + 3.0f*u*u*s*p1[1] + 3.0f*u*s*s*p2[1] + s*s*s*p3[1];
+}
+
+/**
+* Helper function to sample a channel at time t into out.
+*/
+void ColladaResource::SampleChannel(const ChannelSampler& cs, float t, float* out) {
+    const vector<float>& times = cs.times;
+    const vector<float>& values = cs.values;
+    unsigned int stride = cs.stride;
+    unsigned int last = times.size() - 1;
+    unsigned int k = 0, n = 0;
+    float s = 0.0;
+    if (t >= times[last])
+        k = n = last;
+    else if (t > times[0]) {
+        // binary search for the key interval containing t
+        unsigned int lo = 0, hi = last;
+        while (hi - lo > 1) {
+            unsigned int mid = (lo + hi) / 2;
+            if (times[mid] <= t)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        k = lo;
+        n = hi;
+        if (cs.interp[k] == INTERP_BEZIER && times[n] > times[k]) {
+            for (unsigned int i = 0; i < stride; i++) {
+                float p0[2] = { times[k], values[k*stride+i] };
+                float p3[2] = { times[n], values[n*stride+i] };
+                out[i] = EvaluateBezier(p0, &cs.outControl[(k*stride+i)*2],
+                                        &cs.inControl[(n*stride+i)*2], p3, t);
+            }
+            return;
+        }
+        if (cs.interp[k] == INTERP_LINEAR && times[n] > times[k])
+            s = (t - times[k]) / (times[n] - times[k]);
+    }
+    for (unsigned int i = 0; i < stride; i++)
+        out[i] = values[k*stride+i] + (values[n*stride+i] - values[k*stride+i]) * s;
+}
+
+/**
+* Helper function to set up the clips to bake. Every
+* <animation_clip> becomes a clip, and if there are none all
+* animations go into a single clip named "default".
+*/
+void ColladaResource::ReadAnimationClips() {
+    pendingClips.clear();
+    domCOLLADA* dRoot = dae->getDom(file.data());
+
+    vector<domAnimation*> all;
+    domLibrary_animations_Array animLibs = dRoot->getLibrary_animations_array();
+    for (unsigned int l = 0; l < animLibs.getCount(); l++) {
+        domAnimation_Array animArr = animLibs[l]->getAnimation_array();
+        for (unsigned int a = 0; a < animArr.getCount(); a++)
+            all.push_back(animArr[a]);
+    }
+    if (all.empty())
+        return;
+
+    domLibrary_animation_clips_Array clipLibs = dRoot->getLibrary_animation_clips_array();
+    for (unsigned int l = 0; l < clipLibs.getCount(); l++) {
+        domAnimation_clip_Array clipArr = clipLibs[l]->getAnimation_clip_array();
+        for (unsigned int c = 0; c < clipArr.getCount(); c++) {
+            domAnimation_clip* dc = clipArr[c];
+            PendingClip pc;
+            pc.name = dc->getId() != NULL ? dc->getId() : "clip" + Convert::ToString(c);
+            pc.start = dc->getStart();
+            pc.end = dc->getEnd() > dc->getStart() ? dc->getEnd() : -1.0f;
+            domInstanceWithExtra_Array instArr = dc->getInstance_animation_array();
+            for (unsigned int i = 0; i < instArr.getCount(); i++) {
+                domAnimation* a = dynamic_cast<domAnimation*>(instArr[i]->getUrl().getElement().cast());
+                if (a != NULL)
+                    pc.animations.push_back(a);
+            }
+            pendingClips.push_back(pc);
+        }
+    }
+
+    if (pendingClips.empty()) {
+        PendingClip pc;
+        pc.name = "default";
+        pc.animations = all;
+        pc.start = 0.0;
+        pc.end = -1.0;
+        pendingClips.push_back(pc);
+    }
+}
+
+/**
+* Helper function to collect the channels of an animation and its
+* nested animations.
+*/
+void ColladaResource::ReadChannels(domAnimation* anim, vector<domChannel*>& channels) {
+    domChannel_Array chArr = anim->getChannel_array();
+    for (unsigned int i = 0; i < chArr.getCount(); i++)
+        channels.push_back(chArr[i]);
+    domAnimation_Array animArr = anim->getAnimation_array();
+    for (unsigned int i = 0; i < animArr.getCount(); i++)
+        ReadChannels(animArr[i], channels);
+}
+
+/**
+* Helper function to resolve the target of a channel and read its
+* sampler. Targets of the form "node/sid", "node/sid.MEMBER" and
+* "node/sid(i)(j)" are supported.
+*
+* @return false if the channel is unsupported or invalid.
+*/
+bool ColladaResource::ReadChannel(domChannel* ch, ChannelSampler& cs) {
+    string target = ch->getTarget();
+    string::size_type slash = target.find('/');
+    if (slash == string::npos)
+        return false;
+    string id = target.substr(0, slash);
+    string rest = target.substr(slash + 1);
+    string::size_type sep = rest.find_first_of(".(");
+    string sid = rest.substr(0, sep);
+    string member = sep == string::npos ? "" : rest.substr(sep);
+
+    daeIDRef ref(id.c_str());
+    ref.setContainer(ch);
+    domNode* dn = dynamic_cast<domNode*>(ref.getElement());
+    if (dn == NULL)
+        return false;
+
+    // find the transformation element with the sid
+    cs.target = NULL;
+    daeTArray<daeSmartRef<daeElement> > elms;
+    dn->getChildren(elms);
+    for (unsigned int i = 0; i < elms.getCount() && cs.target == NULL; i++) {
+        daeString s = NULL;
+        switch (elms[i]->getElementType()) {
+        case COLLADA_TYPE::TRANSLATE: s = dynamic_cast<domTranslate*>(elms[i].cast())->getSid(); break;
+        case COLLADA_TYPE::ROTATE:    s = dynamic_cast<domRotate*>(elms[i].cast())->getSid(); break;
+        case COLLADA_TYPE::SCALE:     s = dynamic_cast<domScale*>(elms[i].cast())->getSid(); break;
+        case COLLADA_TYPE::MATRIX:    s = dynamic_cast<domMatrix*>(elms[i].cast())->getSid(); break;
+        default: break;
+        }
+        if (s != NULL && sid == s)
+            cs.target = elms[i];
+    }
+    if (cs.target == NULL)
+        return false;
+
+    cs.component = -1;
+    if (member == ".X" || member == ".S") cs.component = 0;
+    else if (member == ".Y" || member == ".T") cs.component = 1;
+    else if (member == ".Z" || member == ".P") cs.component = 2;
+    else if (member == ".ANGLE" || member == ".W") cs.component = 3;
+    else if (member.size() > 0 && member[0] == '(') {
+        int i = 0, j = 0;
+        if (sscanf(member.c_str(), "(%d)(%d)", &i, &j) == 2)
+            cs.component = i * 4 + j;
+        else if (sscanf(member.c_str(), "(%d)", &i) == 1)
+            cs.component = i;
+        else
+            return false;
+    }
+    else if (!member.empty())
+        return false;
+
+    // read the sampler
+    domSampler* smp = dynamic_cast<domSampler*>(ch->getSource().getElement().cast());
+    if (smp == NULL)
+        return false;
+    unsigned int inStride = 1, inTanStride = 0, outTanStride = 0;
+    vector<float> inTangents, outTangents;
+    vector<bool> hermite;
+    cs.interp.clear();
+    domInputLocal_Array inputArr = smp->getInput_array();
+    for (unsigned int i = 0; i < inputArr.getCount(); i++) {
+        domSource* src = dynamic_cast<domSource*>(inputArr[i]->getSource().getElement().cast());
+        if (strcmp(inputArr[i]->getSemantic(), COMMON_PROFILE_INPUT_INPUT) == 0)
+            ReadFloatSource(src, cs.times, inStride);
+        else if (strcmp(inputArr[i]->getSemantic(), COMMON_PROFILE_INPUT_OUTPUT) == 0)
+            ReadFloatSource(src, cs.values, cs.stride);
+        else if (strcmp(inputArr[i]->getSemantic(), COMMON_PROFILE_INPUT_IN_TANGENT) == 0)
+            ReadFloatSource(src, inTangents, inTanStride);
+        else if (strcmp(inputArr[i]->getSemantic(), COMMON_PROFILE_INPUT_OUT_TANGENT) == 0)
+            ReadFloatSource(src, outTangents, outTanStride);
+        else if (strcmp(inputArr[i]->getSemantic(), COMMON_PROFILE_INPUT_INTERPOLATION) == 0 &&
+                 src != NULL && src->getName_array() != NULL) {
+            domListOfNames names = src->getName_array()->getValue();
+            for (unsigned int k = 0; k < names.getCount(); k++) {
+                Interpolation ip = INTERP_LINEAR;
+                if (strcmp(names[k], "STEP") == 0)
+                    ip = INTERP_STEP;
+                else if (strcmp(names[k], "BEZIER") == 0 || strcmp(names[k], "HERMITE") == 0)
+                    ip = INTERP_BEZIER;
+                cs.interp.push_back(ip);
+                hermite.push_back(strcmp(names[k], "HERMITE") == 0);
+            }
+        }
+    }
+    unsigned int keys = cs.times.size();
+    if (keys == 0 || cs.stride > 16 || cs.values.size() < keys * cs.stride)
+        return false;
+    cs.interp.resize(keys, INTERP_LINEAR);
+    hermite.resize(keys, false);
+
+    // curved keys need both tangents as points or values per component
+    bool curves = (inTanStride == cs.stride || inTanStride == 2 * cs.stride) &&
+        (outTanStride == cs.stride || outTanStride == 2 * cs.stride) &&
+        inTangents.size() >= keys * inTanStride && outTangents.size() >= keys * outTanStride;
+    cs.inControl.clear();
+    cs.outControl.clear();
+    if (curves) {
+        cs.inControl.resize(keys * cs.stride * 2);
+        cs.outControl.resize(keys * cs.stride * 2);
+        for (unsigned int k = 0; k < keys; k++) {
+            ReadControls(inTangents, inTanStride, cs.times, cs.values, cs.stride,
+                         k, hermite[k > 0 ? k - 1 : 0], -1.0f, &cs.inControl[k * cs.stride * 2]);
+            ReadControls(outTangents, outTanStride, cs.times, cs.values, cs.stride,
+                         k, hermite[k], 1.0f, &cs.outControl[k * cs.stride * 2]);
+        }
+    } else {
+        for (unsigned int k = 0; k < keys; k++)
+            if (cs.interp[k] == INTERP_BEZIER)
+                cs.interp[k] = INTERP_LINEAR;
+    }
+    return true;
+}
+
+/**
+* Helper function to start baking a clip. Collects the channels of
+* the animations in the clip, they are read by the following steps.
+*/
+unsigned int ColladaResource::BeginClip(PendingClip& pc) {
+    bake.channels.clear();
+    for (unsigned int i = 0; i < pc.animations.size(); i++)
+        ReadChannels(pc.animations[i], bake.channels);
+    bake.samplers.clear();
+    bake.samplers.resize(bake.channels.size());
+    bake.channel = 0;
+    bake.unsupported = 0;
+    bake.end = pc.end;
+    bake.targets.clear();
+    bake.clip = NULL;
+    baking = true;
+    return bake.channels.size() + 1;
+}
+
+/**
+* Helper function to bake a slice of a clip. Every animated
+* transformation element is sampled at the fixed rate, with the
+* static value of the element for components that are not animated,
+* and converted into compressed tracks for the transformation nodes
+* created for it in every instance path.
+*
+* Reading a channel costs a unit per key, resampling an element a
+* unit per frame and channel, and compressing it a unit per frame and
+* track.
+*/
+unsigned int ColladaResource::StepClip(PendingClip& pc, unsigned int budget) {
+    unsigned int work = 0;
+    bool done = false;
+    while (work < budget && !done) {
+        // read the channels and find the end of the clip
+        if (bake.channel < bake.channels.size()) {
+            ChannelSampler& cs = bake.samplers[bake.channel];
+            if (!ReadChannel(bake.channels[bake.channel++], cs)) {
+                bake.unsupported++;
+                work++;
+                continue;
+            }
+            if (pc.end < 0.0f && cs.times.back() > bake.end)
+                bake.end = cs.times.back();
+            bake.targets[cs.target].push_back(&cs);
+            work += cs.times.size();
+            continue;
+        }
+
+        // all channels are read, set up the clip
+        if (bake.clip == NULL) {
+            if (bake.unsupported > 0)
+                log.warning << "Clip " << pc.name << ": ignored " << bake.unsupported
+                            << " unsupported animation channels." << log.end;
+            if (bake.targets.empty()) {
+                done = true;
+                continue;
+            }
+            float end = bake.end < pc.start ? pc.start : bake.end;
+            unsigned int frames = (unsigned int)((end - pc.start) * animRate + 0.5f) + 1;
+            if (frames > AnimationClip::MAX_FRAMES)
+                log.warning << "Clip " << pc.name << " is too long and has been cut." << log.end;
+            bake.clip = new AnimationClip(pc.name, animRate, frames);
+            bake.target = bake.targets.begin();
+            BeginTarget();
+            work++;
+            continue;
+        }
+
+        if (bake.target == bake.targets.end()) {
+            AnimationClip* clip = bake.clip;
+            log.info << "Clip " << pc.name << ": " << clip->GetTrackCount() << " tracks, "
+                     << clip->GetKeyCount() << " of " << clip->GetTrackCount() * clip->GetFrameCount()
+                     << " keys kept, " << clip->GetSize() << " bytes." << log.end;
+            clips.push_back(clip);
+            bake.clip = NULL;
+            done = true;
+            continue;
+        }
+
+        // resample the next frame of all channels of the element
+        unsigned int frames = bake.clip->GetFrameCount();
+        if (bake.frame < frames) {
+            unsigned int n = bake.base.size();
+            float* baked = &bake.baked[bake.frame*n];
+            for (unsigned int i = 0; i < n; i++)
+                baked[i] = bake.base[i];
+            vector<ChannelSampler*>& chs = bake.target->second;
+            float val[16];
+            for (unsigned int c = 0; c < chs.size(); c++) {
+                ChannelSampler* cs = chs[c];
+                SampleChannel(*cs, pc.start + bake.frame / animRate, val);
+                if (cs->component >= 0) {
+                    if ((unsigned int)cs->component < n)
+                        baked[cs->component] = val[0];
+                } else {
+                    for (unsigned int i = 0; i < cs->stride && i < n; i++)
+                        baked[i] = val[i];
+                }
+            }
+            bake.frame++;
+            work += 1 + chs.size();
+            continue;
+        }
+
+        work += BakeTracks();
+        bake.target++;
+        BeginTarget();
+    }
+
+    if (done) {
+        // the clip is done, or had nothing to bake
+        bake.channels.clear();
+        bake.samplers.clear();
+        bake.targets.clear();
+        bake.base.clear();
+        bake.baked.clear();
+        baking = false;
+    }
+    return work > 0 ? work : 1;
+}
+
+/**
+* Helper function to prepare resampling the current target element of
+* the clip being baked, skipping elements no node was created for.
+*/
+void ColladaResource::BeginTarget() {
+    while (bake.target != bake.targets.end() &&
+           transformNodes.find(bake.target->first) == transformNodes.end())
+        bake.target++;
+    if (bake.target == bake.targets.end())
+        return;
+
+    // the static value of the element
+    domListOfFloats base;
+    daeElement* elm = bake.target->first;
+    switch (elm->getElementType()) {
+    case COLLADA_TYPE::TRANSLATE: base = dynamic_cast<domTranslate*>(elm)->getValue(); break;
+    case COLLADA_TYPE::ROTATE:    base = dynamic_cast<domRotate*>(elm)->getValue(); break;
+    case COLLADA_TYPE::SCALE:     base = dynamic_cast<domScale*>(elm)->getValue(); break;
+    case COLLADA_TYPE::MATRIX:    base = dynamic_cast<domMatrix*>(elm)->getValue(); break;
+    }
+    bake.base.resize(base.getCount());
+    for (unsigned int i = 0; i < base.getCount(); i++)
+        bake.base[i] = base[i];
+    bake.baked.resize(bake.clip->GetFrameCount() * bake.base.size());
+    bake.frame = 0;
+}
+
+/**
+* Helper function to convert the resampled values of the current
+* target element into tracks of the clip being baked.
+*
+* @return The amount of work done.
+*/
+unsigned int ColladaResource::BakeTracks() {
+    daeElement* elm = bake.target->first;
+    int type = elm->getElementType();
+    const vector<TransformationNode*>& tns = transformNodes[elm];
+    unsigned int frames = bake.clip->GetFrameCount();
+    unsigned int n = bake.base.size();
+
+    // convert the baked values into tracks, the same way ReadNode
+    // interprets the static values.
+    vector<Vector<3,float> > vecs(frames);
+    vector<Quaternion<float> > rots(frames);
+    for (unsigned int f = 0; f < frames; f++) {
+        float* b = &bake.baked[f*n];
+        if (type == COLLADA_TYPE::MATRIX) {
+            vecs[f] = Vector<3,float>(b[3], b[7], b[11]);
+            rots[f] = Quaternion<float>(Matrix<3,3,float>(b[0],b[1],b[2],
+                                                          b[4],b[5],b[6],
+                                                          b[8],b[9],b[10]));
+        }
+        else if (type == COLLADA_TYPE::ROTATE)
+            rots[f] = Quaternion<float>(b[3], Vector<3,float>(b[0], b[1], b[2]));
+        else
+            vecs[f] = Vector<3,float>(b[0], b[1], b[2]);
+    }
+
+    AnimationClip* clip = bake.clip;
+    unsigned int tracks = clip->GetTrackCount();
+    if (type == COLLADA_TYPE::TRANSLATE || type == COLLADA_TYPE::MATRIX)
+        clip->AddVectorTrack(tns, AnimationClip::TRACK_POSITION, vecs, posTolerance);
+    if (type == COLLADA_TYPE::SCALE)
+        clip->AddVectorTrack(tns, AnimationClip::TRACK_SCALE, vecs, posTolerance);
+    if (type == COLLADA_TYPE::ROTATE || type == COLLADA_TYPE::MATRIX)
+        clip->AddRotationTrack(tns, rots, rotTolerance);
+
+    // animated subtrees are not static
+    if (batcher != NULL)
+        for (unsigned int i = 0; i < tns.size(); i++)
+            batcher->Exclude(tns[i]);
+
+    return frames * (clip->GetTrackCount() - tracks + 1);
+}
+
+/**
+* Helper function to read faces [first;first+count) of a triangle list
+* into a face set.
+*
+* @return The number of faces processed.
+*/
+unsigned int ColladaResource::ReadTriangles(domTriangles* ts, FaceSet* fs,
+                                            unsigned int first, unsigned int count) {
     // Get the material associated with the current triangle list
     daeIDRef mRef(ts->getMaterial());
     mRef.setContainer(ts);
@@ -329,29 +1183,43 @@ void ColladaResource::ReadTriangles(domTriangles* ts, FaceSet* fs) {
     // depending on the input offset (we assume that the highest possible
     // offset is the number of input elements).
     offsetMap = new vector<InputMap*>[inputCount];
+
+    // reset the vertex buffers so missing inputs do not leak values
+    // from the previous triangle list.
+    vertex[0] = vertex[1] = vertex[2] = 0.0;
+    normal[0] = normal[1] = normal[2] = 0.0;
+    texcoord[0] = texcoord[1] = 0.0;
+    color[0] = color[1] = color[2] = 1.0;
+    hasNormal = hasTexcoord = false;
     
     // fill out the offsetMap and find the max offset number            
     int maxOffset = 0;
+    int vertexOffset = -1;
     for (int input = 0; input < inputCount; input++) {
         int offset = inputArr[input]->getOffset();
         if (offset > maxOffset)
             maxOffset = offset;
+        if (strcmp(inputArr[input]->getSemantic(),COMMON_PROFILE_INPUT_VERTEX) == 0)
+            vertexOffset = offset;
         
         ProcessInputLocalOffset(inputArr[input].cast());
     }
     
-    // Start iterating through each p-index
-    int currentP = 0;
+    // Start iterating through each p-index of the first face
+    int currentP = first * 3 * (maxOffset + 1);
     int currentVertex = 0;
     int currentOffset = 0;
-    int currentFace  = 0;
+    unsigned int currentFace  = 0;
     Vector<3,float> vertices[3];
     Vector<3,float> normals[3];
     Vector<2,float> texcoords[3];
     Vector<4,float> colors[3];
+    unsigned int indices[3] = {0, 0, 0};
     
-    while (currentP < pCount) {
+    while (currentP < pCount && currentFace < count) {
         int p = pArr[currentP];
+        if (currentOffset == vertexOffset)
+            indices[currentVertex] = p;
             
         for (vector<InputMap*>::iterator itr = offsetMap[currentOffset].begin();
              itr != offsetMap[currentOffset].end();
@@ -398,9 +1266,16 @@ void ColladaResource::ReadTriangles(domTriangles* ts, FaceSet* fs) {
                     
                     face->mat = m;
                     fs->Add(face);
+
+                    // remember the mesh vertices for skinning
+                    if (vertexIndices != NULL) {
+                        vertexIndices->push_back(indices[0]);
+                        vertexIndices->push_back(indices[1]);
+                        vertexIndices->push_back(indices[2]);
+                    }
                 }
                 catch (Exception e) {
-                    logger.warning << "Face caused an exception: " << e.what() << logger.end;
+                    log.warning << "Face caused an exception: " << e.what() << log.end;
                 } 
                 currentFace++;
             }
@@ -417,6 +1292,7 @@ void ColladaResource::ReadTriangles(domTriangles* ts, FaceSet* fs) {
         }
     }
     delete[] offsetMap;
+    return currentFace;
 }
     
 /**
@@ -437,25 +1313,27 @@ void ColladaResource::InsertInputMap(daeString semantic, domSource* src, int off
     else if (strcmp(semantic,COMMON_PROFILE_INPUT_NORMAL) == 0) {
         im->dest = normal;
         im->size = 3;
+        hasNormal = true;
     }
     
     else if (strcmp(semantic,COMMON_PROFILE_INPUT_TEXCOORD) == 0) {
         im->dest = texcoord;
         im->size = 2;
+        hasTexcoord = true;
     }
     else if (strcmp(semantic,COMMON_PROFILE_INPUT_COLOR) == 0) {
         im->dest = color;
         im->size = 3;
     }
     else {
-        logger.warning << "Ignoring unsupported input type: " << semantic << logger.end;
+        log.warning << "Ignoring unsupported input type: " << semantic << log.end;
         delete im;
         return;
     }
         
     
     if (src->getFloat_array() == NULL) {
-        logger.warning << "No float array present, we only support vertex data in float arrays" << logger.end;
+        log.warning << "No float array present, we only support vertex data in float arrays" << log.end;
     }
 
     im->src = src->getFloat_array()->getValue(); // assume that all source elements contain float arrays
@@ -464,7 +1342,7 @@ void ColladaResource::InsertInputMap(daeString semantic, domSource* src, int off
         // TODO: find out what the default action is when no accessor is found
         im->stride = 1; 
         im->size = 0;
-        logger.warning << "Found source without accessor." << logger.end;
+        log.warning << "Found source without accessor." << log.end;
     } else {
         im->stride = src->getTechnique_common()->getAccessor()->getStride();
     }
@@ -510,13 +1388,115 @@ void ColladaResource::ProcessInputLocalOffset(domInputLocalOffset* input) {
 void ColladaResource::Load() {
     
     // check if we have loaded the resource
-    if (root != NULL) return;
-  
+    if (state == LOAD_DONE) return;
+
+    // run the remaining load steps without a budget
+    while (!Step(UINT_MAX));
+}
+
+/**
+ * Start loading the resource incrementally.
+ * No work is done until Step() is called, which also starts loading
+ * if needed.
+ *
+ * @see Step()
+ */
+void ColladaResource::BeginLoad() {
+    if (state != LOAD_IDLE) return;
+    state = LOAD_PARSE;
+}
+
+/**
+ * Perform at most the given amount of loading work.
+ *
+ * Work is measured in units of roughly one triangle, material or
+ * scene node. Meshes are read, their normals and tangents are
+ * generated and animations are baked in slices of the budget, but
+ * parsing the file and batching are indivisible and always use a
+ * full step.
+ *
+ * Between steps the scene graph returned by GetSceneNode() is
+ * consistent: nodes are only attached once they are complete.
+ *
+ * Budgeted steps do all work on the calling thread, as starting and
+ * joining worker threads would cost more than a frame slice. Only
+ * steps with a budget of UINT_MAX, as run by Load(), use the worker
+ * threads.
+ *
+ * @param budget Amount of work to do in this step.
+ * @return True when loading has finished.
+ */
+bool ColladaResource::Step(unsigned int budget) {
+    unsigned int work = 0;
+    if (budget == 0) budget = 1;
+    parallel = budget == UINT_MAX;
+
+    while (work < budget) {
+        switch (state) {
+        case LOAD_IDLE:
+            BeginLoad();
+            break;
+        case LOAD_DONE:
+            return true;
+        case LOAD_PARSE:
+            StepParse();
+            state = LOAD_MATERIALS;
+            return false;
+        case LOAD_MATERIALS:
+            work += StepMaterials();
+            break;
+        case LOAD_MESHES:
+            work += StepMeshes(budget - work);
+            break;
+        case LOAD_TANGENTS:
+            work += StepTangents(budget - work);
+            break;
+        case LOAD_NODES:
+            work += StepNodes();
+            break;
+        case LOAD_SKINS:
+            work += StepSkins();
+            break;
+        case LOAD_ANIMATIONS:
+            work += StepAnimations(budget - work);
+            break;
+        case LOAD_BATCH:
+            // merge static geometry into material sorted batches
+            if (batcher != NULL) {
+                batcher->Batch(root, tangents);
+                if (batcher->GetFailedFaceCount() > 0)
+                    log.warning << "Batching dropped " << batcher->GetFailedFaceCount()
+                                << " faces that caused an exception." << log.end;
+                log.info << "Batched " << batcher->GetSourceCount() << " geometry nodes into "
+                         << batcher->GetBatchCount() << " batches." << log.end;
+            }
+            // with shared caches the document is not needed anymore
+            if (context != NULL)
+                ReleaseDatabase();
+            state = LOAD_DONE;
+            return true;
+        }
+    }
+    return state == LOAD_DONE;
+}
+
+/**
+ * Check if the resource has been completely loaded.
+ */
+bool ColladaResource::IsLoaded() {
+    return state == LOAD_DONE;
+}
+
+/**
+ * Parse the file and set up the root node.
+ */
+void ColladaResource::StepParse() {
+    ReleaseDatabase();
 
     //initialize the collada database
-    dae = new DAE();
+    dae = context != NULL ? context->CreateDatabase() : new DAE();
 
-    int err = dae->load(file.data());
+    int err = context != NULL ? context->LoadDatabase(dae, file) : dae->load(file.data());
     if (err != DAE_OK)
         throw Exception("Error opening Collada file: " + file);
   
@@ -546,27 +1526,331 @@ void ColladaResource::Load() {
     yUp = true;
     domCOLLADA* dRoot = dae->getDom(file.data());
     if (dRoot->getAsset()->getUp_axis()->getValue() == UPAXISTYPE_Z_UP) {
-        logger.info << "rotating" << logger.end;
+        log.info << "rotating" << log.end;
         yUp = false;
         rot = Quaternion<float>(-PI*0.5,Vector<3,float>(1.0,0.0,0.0));
         //root->SetRotation(q);
     }
     
 
-    // process all <node> elements in the visual scene
+    // queue all <node> elements in the visual scene
     domVisual_scene* vs = 
         dynamic_cast<domVisual_scene*>(scene->getInstance_visual_scene()->getUrl().getElement().cast());
     domNode_Array nodeArr = vs->getNode_array();
+    pendingNodes.clear();
+    pathParents.assign(1, 0);
+    for (unsigned int n = nodeArr.getCount(); n > 0; n--) {
+        PendingNode pn;
+        pn.node = nodeArr[n-1];
+        pn.parent = root;
+        pn.path = 0;
+        pendingNodes.push_back(pn);
+    }
+
+    // find the geometries instanced by the scene, only these are read.
+    pendingGeometries.clear();
+    skinnedGeometries.clear();
+    set<daeElement*> visited;
+    for (unsigned int n = 0; n < nodeArr.getCount(); n++)
+        CollectGeometries(nodeArr[n], visited);
+
+    // and the materials used by these geometries
+    pendingMaterials.clear();
+    for (unsigned int g = 0; g < pendingGeometries.size(); g++) {
+        domMesh* mesh = pendingGeometries[g]->getMesh();
+        if (mesh == NULL)
+            continue;
+        domTriangles_Array trianglesArr = mesh->getTriangles_array();
+        for (unsigned int t = 0; t < trianglesArr.getCount(); t++) {
+            daeIDRef mRef(trianglesArr[t]->getMaterial());
+            mRef.setContainer(trianglesArr[t]);
+            domMaterial* dm = dynamic_cast<domMaterial*>(mRef.getElement());
+            if (dm != NULL && visited.insert(dm).second)
+                pendingMaterials.push_back(dm);
+        }
+    }
+    stateIndex = 0;
+}
+
+/**
+ * Queue the geometries instanced below a node, directly or through
+ * a skin controller. For skinned geometries we need to keep track of
+ * their mesh vertices when reading them.
+ */
+void ColladaResource::CollectGeometries(domNode* dn, set<daeElement*>& visited) {
+    if (!visited.insert(dn).second)
+        return;
+
+    domInstance_geometry_Array geomArr = dn->getInstance_geometry_array();
+    for (unsigned int g = 0; g < geomArr.getCount(); g++) {
+        domGeometry* geom = dynamic_cast<domGeometry*>(geomArr[g]->getUrl().getElement().cast());
+        if (geom != NULL && visited.insert(geom).second)
+            pendingGeometries.push_back(geom);
+    }
+
+    domInstance_controller_Array ctrlArr = dn->getInstance_controller_array();
+    for (unsigned int c = 0; c < ctrlArr.getCount(); c++) {
+        domController* ctrl = dynamic_cast<domController*>(ctrlArr[c]->getUrl().getElement().cast());
+        if (ctrl == NULL || ctrl->getSkin() == NULL)
+            continue;
+        domGeometry* geom = dynamic_cast<domGeometry*>(ctrl->getSkin()->getSource().getElement().cast());
+        if (geom == NULL)
+            continue;
+        skinnedGeometries.insert(geom);
+        if (visited.insert(geom).second)
+            pendingGeometries.push_back(geom);
+    }
 
-    // recursively process each node element
-    for (unsigned int n = 0; n < nodeArr.getCount(); n++) {
-        ReadNode(nodeArr[n], root);
+    domInstance_node_Array instArr = dn->getInstance_node_array();
+    for (unsigned int n = 0; n < instArr.getCount(); n++) {
+        domNode* in = dynamic_cast<domNode*>(instArr[n]->getUrl().getElement().cast());
+        if (in != NULL)
+            CollectGeometries(in, visited);
     }
+
+    domNode_Array childArr = dn->getNode_array();
+    for (unsigned int n = 0; n < childArr.getCount(); n++)
+        CollectGeometries(childArr[n], visited);
 }
 
-// Helper method to recursively process a domNode in order 
-// to fill out the scene graph with transformation and geometry nodes.
-void ColladaResource::ReadNode(domNode* dn, ISceneNode* sn) {
+/**
+ * Load the next material used by the instanced geometries.
+ */
+unsigned int ColladaResource::StepMaterials() {
+    if (stateIndex >= pendingMaterials.size()) {
+        pendingMaterials.clear();
+        state = LOAD_MESHES;
+        stateIndex = 0;
+        return 0;
+    }
+
+    domMaterial* dm = pendingMaterials[stateIndex++];
+    if (dm->getID() != NULL)
+        LoadMaterial(dm);
+    return 1;
+}
+
+/**
+ * Read a slice of the current mesh, starting the next geometry
+ * instanced by the scene if none is in progress.
+ */
+unsigned int ColladaResource::StepMeshes(unsigned int budget) {
+    if (currentGeometry == NULL) {
+        if (stateIndex >= pendingGeometries.size()) {
+            pendingGeometries.clear();
+            state = LOAD_TANGENTS;
+            stateIndex = 0;
+            return 0;
+        }
+
+        domGeometry* geom = pendingGeometries[stateIndex++];
+        if (geom->getID() == NULL)
+            return 1;
+        domMesh* mesh = geom->getMesh();
+        if (mesh == NULL) {
+            log.warning << "Unsupported geometry type in: " << geom->getID() << log.end;
+            return 1;
+        }
+
+        // Display warnings if unsupported geometry types are defined
+        if (mesh->getLines_array().getCount() > 0)
+            log.warning << "Unsupported geometry types found: Lines" << log.end;
+        if (mesh->getLinestrips_array().getCount() > 0)
+            log.warning << "Unsupported geometry types found: Linestrips" << log.end;
+        if (mesh->getPolygons_array().getCount() > 0)
+            log.warning << "Unsupported geometry types found: Polygons" << log.end;
+        if (mesh->getPolylist_array().getCount() > 0)
+            log.warning << "Unsupported geometry types found: Polylist" << log.end;
+        if (mesh->getTrifans_array().getCount() > 0)
+            log.warning << "Unsupported geometry types found: Trifans" << log.end;
+        if (mesh->getTristrips_array().getCount() > 0)
+            log.warning << "Unsupported geometry types found: Tristrips" << log.end;
+
+        // reuse the geometry if another resource has loaded it
+        string key;
+        if (context != NULL && skinnedGeometries.find(geom) == skinnedGeometries.end()) {
+            key = GeometryKey(geom);
+            TangentListPtr tl;
+            FaceSet* fs = context->FindGeometry(key, tl);
+            if (fs != NULL) {
+                geometries[geom] = fs;
+                if (tl.get() != NULL)
+                    tangents[fs] = tl;
+                return 1;
+            }
+        }
+
+        currentGeometry = geom;
+        currentMesh.fs = new FaceSet();
+        currentMesh.genNormals.clear();
+        currentMesh.texcoords = false;
+        currentMesh.geom = geom;
+        currentMesh.key = key;
+        trianglesIndex = 0;
+        faceIndex = 0;
+    }
+
+    // read a slice of the current triangle list into our face set and
+    // remember which faces came without normals.
+    domTriangles_Array trianglesArr = currentGeometry->getMesh()->getTriangles_array();
+    if (trianglesIndex < trianglesArr.getCount()) {
+        domTriangles* ts = trianglesArr[trianglesIndex];
+        unsigned int count = ts->getCount() - faceIndex;
+        if (count > budget)
+            count = budget;
+        vertexIndices = NULL;
+        if (skinnedGeometries.find(currentGeometry) != skinnedGeometries.end())
+            vertexIndices = &skinVertices[currentGeometry];
+        ReadTriangles(ts, currentMesh.fs, faceIndex, count);
+        vertexIndices = NULL;
+        currentMesh.genNormals.resize(currentMesh.fs->Size(), !hasNormal);
+        currentMesh.texcoords = currentMesh.texcoords || hasTexcoord;
+
+        faceIndex += count;
+        if (faceIndex >= ts->getCount()) {
+            trianglesIndex++;
+            faceIndex = 0;
+        }
+        return count > 0 ? count : 1;
+    }
+
+    // the mesh is complete
+    geometries[currentGeometry] = currentMesh.fs;
+    pendingMeshes.push_back(currentMesh);
+    currentGeometry = NULL;
+    return 1;
+}
+
+/**
+ * Generate missing normals and tangents for the loaded meshes in
+ * slices of the budget. Once all meshes are done they are shared one
+ * at a time.
+ */
+unsigned int ColladaResource::StepTangents(unsigned int budget) {
+    if (generator == NULL && stateIndex == 0) {
+        generator = new TangentSpaceGenerator();
+        generator->SetCreaseAngle(creaseAngle);
+        for (unsigned int i = 0; i < pendingMeshes.size(); i++) {
+            PendingMesh& pm = pendingMeshes[i];
+            TangentList* tl = NULL;
+            if (genTangents && pm.texcoords) {
+                tl = new TangentList();
+                tangents[pm.fs] = TangentListPtr(tl);
+            }
+            generator->AddMesh(pm.fs, pm.genNormals, tl);
+        }
+    }
+    if (generator != NULL) {
+        if (!generator->IsDone()) {
+            generator->SetThreadCount(parallel ? threads : 1);
+            return generator->Step(budget);
+        }
+        delete generator;
+        generator = NULL;
+    }
+
+    if (stateIndex >= pendingMeshes.size()) {
+        pendingMeshes.clear();
+        state = LOAD_NODES;
+        stateIndex = 0;
+        return 0;
+    }
+
+    // the mesh is complete and can be shared
+    PendingMesh& pm = pendingMeshes[stateIndex++];
+    if (context == NULL)
+        return 1;
+    if (context->GetDeduplication() &&
+        skinnedGeometries.find(pm.geom) == skinnedGeometries.end())
+        Deduplicate(pm);
+    if (!pm.key.empty()) {
+        map<FaceSet*, TangentListPtr>::iterator itr = tangents.find(pm.fs);
+        context->AddGeometry(pm.key, pm.fs, itr != tangents.end() ? itr->second : TangentListPtr());
+    }
+    return pm.fs->Size() > 0 ? pm.fs->Size() : 1;
+}
+
+/**
+ * Replace a mesh by an identical mesh loaded earlier, by this or
+ * another resource using the import context.
+ */
+void ColladaResource::Deduplicate(PendingMesh& pm) {
+    TangentListPtr tl;
+    map<FaceSet*, TangentListPtr>::iterator itr = tangents.find(pm.fs);
+    if (itr != tangents.end())
+        tl = itr->second;
+    FaceSet* fs = context->Deduplicate(pm.fs, tl);
+    if (fs == NULL)
+        return;
+
+    // share the faces and tangents of the identical mesh
+    if (itr != tangents.end()) {
+        tangents.erase(itr);
+        tangents[fs] = tl;
+    }
+    geometries[pm.geom] = fs;
+    delete pm.fs;
+    pm.fs = fs;
+}
+
+/**
+ * Read the next pending scene node.
+ */
+unsigned int ColladaResource::StepNodes() {
+    if (pendingNodes.empty()) {
+        state = LOAD_SKINS;
+        stateIndex = 0;
+        return 0;
+    }
+
+    PendingNode next = pendingNodes.back();
+    pendingNodes.pop_back();
+    ReadNode(next.node, next.parent, next.path);
+    return 1 + next.node->getInstance_geometry_array().getCount()
+        + next.node->getInstance_controller_array().getCount();
+}
+
+/**
+ * Resolve the joints of the next skin now that the node graph is
+ * complete.
+ */
+unsigned int ColladaResource::StepSkins() {
+    if (stateIndex >= pendingSkins.size()) {
+        pendingSkins.clear();
+        ReadAnimationClips();
+        state = LOAD_ANIMATIONS;
+        stateIndex = 0;
+        return 0;
+    }
+    PendingSkin& ps = pendingSkins[stateIndex++];
+    ResolveJoints(ps);
+    return ps.skin->jointNames.size() + 1;
+}
+
+/**
+ * Bake a slice of the current animation clip, starting the next clip
+ * if none is in progress.
+ */
+unsigned int ColladaResource::StepAnimations(unsigned int budget) {
+    if (!baking) {
+        if (stateIndex >= pendingClips.size()) {
+            pendingClips.clear();
+            state = LOAD_BATCH;
+            return 0;
+        }
+        return BeginClip(pendingClips[stateIndex]);
+    }
+
+    unsigned int work = StepClip(pendingClips[stateIndex], budget);
+    if (!baking)
+        stateIndex++;
+    return work;
+}
+
+// Helper method to process a domNode in order to fill out the scene
+// graph with transformation and geometry nodes. Instanced nodes are
+// queued for later steps in a new instance path.
+void ColladaResource::ReadNode(domNode* dn, ISceneNode* sn, unsigned int path) {
     ISceneNode* node = sn;
     TransformationNode* tn;
 
@@ -577,8 +1861,8 @@ void ColladaResource::ReadNode(domNode* dn, ISceneNode* sn) {
     // TODO: tidy up a bit and ensure that the transformation nodes are correct!
     for (unsigned int i = 0; i < elms.getCount(); i++) {
         if (elms[i]->getElementType() == COLLADA_TYPE::LOOKAT) {
-            logger.warning << "ColladaResource: Look At transformation not supported." 
-                           << logger.end;
+            log.warning << "ColladaResource: Look At transformation not supported." 
+                        << log.end;
             continue;
         }
 
@@ -599,6 +1883,7 @@ void ColladaResource::ReadNode(domNode* dn, ISceneNode* sn) {
                                            0,0,1,0,
                                            m[12],m[13],m[14],1));
             node->AddNode(tn);
+            transformNodes[elms[i]].push_back(tn);
             node = tn;
             continue;
         }
@@ -611,6 +1896,7 @@ void ColladaResource::ReadNode(domNode* dn, ISceneNode* sn) {
             tn = new TransformationNode();
             tn->SetRotation(q);
             node->AddNode(tn);
+            transformNodes[elms[i]].push_back(tn);
             node = tn;
             continue;
         }
@@ -622,13 +1908,14 @@ void ColladaResource::ReadNode(domNode* dn, ISceneNode* sn) {
             tn->Scale(scale[0],scale[1],scale[2]);
 
             node->AddNode(tn);
+            transformNodes[elms[i]].push_back(tn);
             node = tn;
             continue;
         }
         
         if (elms[i]->getElementType() == COLLADA_TYPE::SKEW) {
-            logger.warning << "ColladaResource: Skew transformation not supported"
-                           << logger.end;
+            log.warning << "ColladaResource: Skew transformation not supported"
+                        << log.end;
             
             continue;
         }
@@ -639,24 +1926,65 @@ void ColladaResource::ReadNode(domNode* dn, ISceneNode* sn) {
             tn = new TransformationNode();
             tn->Move(trans[0], trans[1], trans[2]);
             node->AddNode(tn);
+            transformNodes[elms[i]].push_back(tn);
             node = tn;
         }
     }
     
+    // give nodes without transformations a node of their own, so
+    // joints never share a scene node with their parent
+    if (node == sn) {
+        tn = new TransformationNode();
+        sn->AddNode(tn);
+        node = tn;
+    }
+
+    // remember the scene node of each dom node for joint lookups
+    sceneNodes[make_pair(dn, path)] = node;
+
     // process each <instance_geometry> element
     domInstance_geometry_Array geomArr = dn->getInstance_geometry_array();
     for (unsigned int g = 0; g < geomArr.getCount(); g++) {
         GeometryNode* gn = 
             LoadGeometry(geomArr[g]);
         if (!gn) 
-            logger.warning << "Invalid geometry url." << logger.end;
+            log.warning << "Invalid geometry url." << log.end;
+        else
+            node->AddNode(gn);
+    }
+    
+    // process each <instance_controller> element
+    domInstance_controller_Array ctrlArr = dn->getInstance_controller_array();
+    for (unsigned int c = 0; c < ctrlArr.getCount(); c++) {
+        GeometryNode* gn = 
+            LoadController(ctrlArr[c], path);
+        if (!gn) 
+            log.warning << "Invalid or unsupported controller." << log.end;
         else
             node->AddNode(gn);
     }
     
     domInstance_node_Array nodeArr = dn->getInstance_node_array();
-    for (unsigned int n = 0; n < nodeArr.getCount(); n++) {
-        ReadNode(dynamic_cast<domNode*>(nodeArr[n]->getUrl().getElement().cast()), node);
+    for (unsigned int n = nodeArr.getCount(); n > 0; n--) {
+        domNode* in = dynamic_cast<domNode*>(nodeArr[n-1]->getUrl().getElement().cast());
+        if (in == NULL)
+            continue;
+        PendingNode pn;
+        pn.node = in;
+        pn.parent = node;
+        pn.path = pathParents.size();
+        pathParents.push_back(path);
+        pendingNodes.push_back(pn);
+    }
+
+    // child nodes, these hold eg. the joints of a skeleton
+    domNode_Array childArr = dn->getNode_array();
+    for (unsigned int n = childArr.getCount(); n > 0; n--) {
+        PendingNode pn;
+        pn.node = childArr[n-1];
+        pn.parent = node;
+        pn.path = path;
+        pendingNodes.push_back(pn);
     }
 }
 
@@ -666,10 +1994,61 @@ void ColladaResource::ReadNode(domNode* dn, ISceneNode* sn) {
  */
 void ColladaResource::Unload() {
     root = NULL;
-    if (dae != NULL) {
+    state = LOAD_IDLE;
+    // the meshes belong to the resource, the geometry nodes have their
+    // own face sets
+    if (currentGeometry != NULL)
+        delete currentMesh.fs;
+    currentGeometry = NULL;
+    if (generator != NULL)
+        delete generator;
+    generator = NULL;
+    for (map<domGeometry*, FaceSet*>::iterator itr = geometries.begin();
+         itr != geometries.end(); itr++)
+        delete itr->second;
+    geometries.clear();
+    pendingGeometries.clear();
+    pendingMaterials.clear();
+    pendingMeshes.clear();
+    pendingNodes.clear();
+    pendingSkins.clear();
+    skinnedGeometries.clear();
+    skinVertices.clear();
+    sceneNodes.clear();
+    skinNodes.clear();
+    pathParents.clear();
+    for (vector<Skin*>::iterator itr = skins.begin(); itr != skins.end(); itr++)
+        delete *itr;
+    skins.clear();
+    pendingClips.clear();
+    if (baking && bake.clip != NULL)
+        delete bake.clip;
+    bake.clip = NULL;
+    bake.channels.clear();
+    bake.samplers.clear();
+    bake.targets.clear();
+    baking = false;
+    transformNodes.clear();
+    for (vector<AnimationClip*>::iterator itr = clips.begin(); itr != clips.end(); itr++)
+        delete *itr;
+    clips.clear();
+    if (batcher != NULL)
+        batcher->Clear();
+    tangents.clear();
+    ReleaseDatabase();
+}
+
+/**
+* Helper function to delete the Collada database.
+*/
+void ColladaResource::ReleaseDatabase() {
+    if (dae == NULL)
+        return;
+    if (context != NULL)
+        context->DestroyDatabase(dae);
+    else
         delete dae;
-        dae = NULL;
-    }
+    dae = NULL;
 }
 
 /**
@@ -681,5 +2060,150 @@ ISceneNode* ColladaResource::GetSceneNode() {
     return root;
 }
 
+/**
+ * Share materials, textures and geometries with other resources
+ * using the same context. Must be set before loading. The Collada
+ * document is released as soon as loading is done.
+ *
+ * @see ColladaImporter
+ */
+void ColladaResource::SetImportContext(ColladaImportContext* context) {
+    this->context = context;
+}
+
+/**
+ * Queue log messages instead of writing them to the logger. Resources
+ * loading on worker threads must not write to the shared logger.
+ *
+ * @param queue List the messages are appended to, NULL to write
+ *              messages to the logger again.
+ * @see ColladaLog
+ */
+void ColladaResource::SetMessageQueue(vector<ColladaMessage>* queue) {
+    log.SetQueue(queue);
+}
+
+/**
+ * Enable or disable tangent generation for meshes with texture
+ * coordinates. Must be set before loading. Missing normals are
+ * always generated.
+ */
+void ColladaResource::SetTangentGeneration(bool enable) {
+    genTangents = enable;
+}
+
+/**
+ * Set the crease angle used when generating missing normals.
+ * Must be set before loading.
+ *
+ * @param radians Crease angle in radians.
+ */
+void ColladaResource::SetCreaseAngle(float radians) {
+    creaseAngle = radians;
+}
+
+/**
+ * Get the generated tangent frames for a loaded face set.
+ * The list is ordered as the faces in the face set and is owned by
+ * the resource until it is unloaded.
+ *
+ * @param fs Face set from the loaded scene graph.
+ * @return Tangent list or NULL if none was generated.
+ */
+TangentList* ColladaResource::GetTangents(FaceSet* fs) {
+    map<FaceSet*, TangentListPtr>::iterator itr = tangents.find(fs);
+    if (itr == tangents.end())
+        return NULL;
+    return itr->second.get();
+}
+
+/**
+ * Set the maximum number of worker threads used by Load(). A value
+ * of one keeps all work on the calling thread. Budgeted calls to
+ * Step() always run on the calling thread.
+ */
+void ColladaResource::SetThreadCount(unsigned int threads) {
+    this->threads = threads > 0 ? threads : 1;
+}
+
+/**
+ * Enable or disable batching of static geometry by material.
+ * Must be set before loading.
+ *
+ * @see GeometryBatcher
+ */
+void ColladaResource::SetBatching(bool enable) {
+    if (enable && batcher == NULL)
+        batcher = new GeometryBatcher();
+    else if (!enable && batcher != NULL) {
+        delete batcher;
+        batcher = NULL;
+    }
+}
+
+/**
+ * Get the geometry batcher, used to configure batching before
+ * loading and to map batched faces back to their source nodes.
+ *
+ * @return The batcher or NULL if batching is disabled.
+ */
+GeometryBatcher* ColladaResource::GetBatcher() {
+    return batcher;
+}
+
+/**
+ * Set the size of the encoded skin weights.
+ * Must be set before loading.
+ */
+void ColladaResource::SetSkinWeightFormat(SkinWeightFormat format) {
+    skinFormat = format;
+}
+
+/**
+ * Get the skin of a skinned geometry node.
+ * The skin is owned by the resource until it is unloaded.
+ *
+ * @param node Geometry node from the loaded scene graph.
+ * @return The skin or NULL if the node is not skinned.
+ */
+Skin* ColladaResource::GetSkin(GeometryNode* node) {
+    map<GeometryNode*, Skin*>::iterator itr = skinNodes.find(node);
+    if (itr == skinNodes.end())
+        return NULL;
+    return itr->second;
+}
+
+/**
+ * Set the rate animations are baked at in frames per second.
+ * Must be set before loading.
+ */
+void ColladaResource::SetAnimationSampleRate(float rate) {
+    animRate = rate > 0.0f ? rate : 1.0f;
+}
+
+/**
+ * Set the error tolerances used when removing redundant keys.
+ * Must be set before loading.
+ *
+ * @param position Maximum error of position and scale components.
+ * @param rotation Maximum error of quaternion components.
+ */
+void ColladaResource::SetAnimationTolerance(float position, float rotation) {
+    posTolerance = position;
+    rotTolerance = rotation;
+}
+
+unsigned int ColladaResource::GetAnimationClipCount() {
+    return clips.size();
+}
+
+/**
+ * Get a baked animation clip.
+ * The clip is owned by the resource until it is unloaded.
+ */
+AnimationClip* ColladaResource::GetAnimationClip(unsigned int i) {
+    return clips[i];
+}
+
 } // NS Resources
 } // NS OpenEngine
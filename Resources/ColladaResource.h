@@ -13,12 +13,19 @@
 
 #include <Resources/IModelResource.h>
 #include <Resources/IResourcePlugin.h>
+#include <Resources/TangentSpaceGenerator.h>
+#include <Resources/GeometryBatcher.h>
+#include <Resources/ColladaSkin.h>
+#include <Resources/AnimationClip.h>
+#include <Resources/ColladaImportContext.h>
+#include <Resources/ColladaLog.h>
 #include <Geometry/Material.h>
 #include <Math/Quaternion.h>
 
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 
 // Collada dom classes
 #include <dae.h>
@@ -51,7 +58,87 @@ using namespace std;
  */
 class ColladaResource : public IModelResource {
 private:
+
+    //! States of the incremental loader, in the order they are run.
+    enum LoadState {
+        LOAD_IDLE,
+        LOAD_PARSE,
+        LOAD_MATERIALS,
+        LOAD_MESHES,
+        LOAD_TANGENTS,
+        LOAD_NODES,
+        LOAD_SKINS,
+        LOAD_ANIMATIONS,
+        LOAD_BATCH,
+        LOAD_DONE
+    };
+
+    //! A loaded mesh waiting for normal and tangent generation.
+    struct PendingMesh {
+        FaceSet* fs;
+        vector<bool> genNormals;
+        bool texcoords;
+        domGeometry* geom;
+        string key;                   //!< import context key, empty if not shared
+    };
+
+    //! A node waiting to be read. Nodes reached through an
+    //! <instance_node> are read once for every instance path.
+    struct PendingNode {
+        domNode* node;
+        ISceneNode* parent;
+        unsigned int path;            //!< instance path the node is read in
+    };
+
+    //! A loaded skin waiting for its joints to be resolved.
+    struct PendingSkin {
+        Skin* skin;
+        domInstance_controller* instance;
+        unsigned int path;            //!< instance path of the controller
+        bool idRefs;                  //!< joints are given by id instead of sid
+    };
+
+    //! An animation clip waiting to be baked.
+    struct PendingClip {
+        string name;
+        vector<domAnimation*> animations;
+        float start, end;             //!< end < 0 means the end of the last key
+    };
+
+    //! Interpolation from a key to the next key.
+    enum Interpolation {
+        INTERP_LINEAR,
+        INTERP_STEP,
+        INTERP_BEZIER                 //!< bezier and hermite keys
+    };
+
+    //! A channel with its sampler data, used while baking.
+    struct ChannelSampler {
+        daeElement* target;           //!< the animated transformation element
+        int component;                //!< animated component or -1 for all
+        vector<float> times;
+        vector<float> values;
+        unsigned int stride;
+        vector<Interpolation> interp; //!< interpolation after each key
+        vector<float> inControl;      //!< bezier control point (time, value) before each key value
+        vector<float> outControl;     //!< bezier control point (time, value) after each key value
+    };
     
+    //! A clip being baked, kept between load steps.
+    struct ClipBake {
+        vector<domChannel*> channels;
+        vector<ChannelSampler> samplers; //!< one per channel
+        unsigned int channel;         //!< next channel to read
+        unsigned int unsupported;     //!< channels that could not be read
+        float end;                    //!< end of the last key read
+        map<daeElement*, vector<ChannelSampler*> > targets;
+        map<daeElement*, vector<ChannelSampler*> >::iterator target; //!< element being resampled
+        vector<float> base;           //!< static value of the element
+        vector<float> baked;          //!< resampled values of the element
+        unsigned int frame;           //!< next frame to resample
+        AnimationClip* clip;          //!< NULL until all channels are read
+    };
+
     struct InputMap{
         int size;            //!< the number of floats to write(assume that all data arrays are of type float)
         int stride;          //!< the p index must be multiplied with this number
@@ -62,13 +149,46 @@ private:
     // data caches
     map<string, MaterialPtr> materials;
     map<string,domCommon_newparam_type*> params;
+    map<domGeometry*, FaceSet*> geometries; //!< meshes owned by the resource
     
     Quaternion<float> rot;
     bool yUp;
 
     float vertex[3], normal[3], texcoord[2], color[3]; //!< buffers for the vertex data
+    bool hasNormal, hasTexcoord;      //!< inputs present in the current triangle list
     vector<InputMap*>* offsetMap;
 
+    // normal and tangent generation
+    bool genTangents;
+    float creaseAngle;
+    unsigned int threads;
+    bool parallel;                    //!< the current step has no budget and may use threads
+    map<FaceSet*, TangentListPtr> tangents; //!< by mesh and by the face set of each instance
+    TangentSpaceGenerator* generator; //!< processes the pending meshes, NULL when idle
+
+    GeometryBatcher* batcher;         //!< NULL unless batching is enabled
+
+    // skinning
+    SkinWeightFormat skinFormat;
+    set<domGeometry*> skinnedGeometries;
+    map<domGeometry*, vector<unsigned int> > skinVertices; //!< mesh vertex of each face corner
+    vector<unsigned int>* vertexIndices; //!< where ReadTriangles records mesh vertices
+    vector<Skin*> skins;              //!< one skin per controller instance
+    map<GeometryNode*, Skin*> skinNodes;
+    map<pair<domNode*, unsigned int>, ISceneNode*> sceneNodes; //!< by node and instance path
+    vector<unsigned int> pathParents; //!< enclosing path of each instance path, 0 is the scene
+
+    // animation
+    float animRate, posTolerance, rotTolerance;
+    map<daeElement*, vector<TransformationNode*> > transformNodes; //!< nodes created for each transformation element, one per instance
+    vector<AnimationClip*> clips;
+    ClipBake bake;
+    bool baking;                      //!< a clip is being baked
+
+    ColladaImportContext* context;    //!< NULL unless imported with shared caches
+    string textureKey;                //!< textures of the material being read
+    ColladaLog log;                   //!< written to the logger or queued for the importer
+
     string file;                      //!< collada file path
     TransformationNode* root;                 //!< the root node
     //    map<string, Material*> materials; //!< resources material map
@@ -76,14 +196,55 @@ private:
     // Collada DOM pointers
     DAE *dae;
 
+    // incremental loading state
+    LoadState state;
+    unsigned int stateIndex;          //!< element index within the current state
+    vector<domMaterial*> pendingMaterials; //!< materials used by the instanced geometries
+    vector<domGeometry*> pendingGeometries; //!< geometries instanced by the scene
+    domGeometry* currentGeometry;     //!< mesh being read
+    PendingMesh currentMesh;
+    unsigned int trianglesIndex;      //!< triangle list within the current mesh
+    unsigned int faceIndex;           //!< face within the current triangle list
+    vector<PendingMesh> pendingMeshes;
+    vector<PendingNode> pendingNodes;
+    vector<PendingSkin> pendingSkins;
+    vector<PendingClip> pendingClips;
+
+    void StepParse();
+    unsigned int StepMaterials();
+    unsigned int StepMeshes(unsigned int budget);
+    unsigned int StepTangents(unsigned int budget);
+    unsigned int StepNodes();
+    unsigned int StepSkins();
+    unsigned int StepAnimations(unsigned int budget);
+
     // helper methods
+    void CollectGeometries(domNode* dn, set<daeElement*>& visited);
     GeometryNode* LoadGeometry(domInstance_geometry* geom);
+    GeometryNode* CreateGeometryNode(FaceSet* mesh);
+    GeometryNode* LoadController(domInstance_controller* cInst, unsigned int path);
     MaterialPtr LoadMaterial(domMaterial* dm);
 
     void ReadImage(domImage* img, MaterialPtr m);
-    void ReadNode(domNode* dNode, ISceneNode* sNode);
+    string MaterialKey(MaterialPtr m);
+    string GeometryKey(domGeometry* geom);
+    void Deduplicate(PendingMesh& pm);
+    void ReleaseDatabase();
+    Skin* ReadSkin(domSkin* skin, const vector<unsigned int>& corners, bool& idRefs);
+    void ResolveJoints(PendingSkin& ps);
+    ISceneNode* FindSceneNode(domNode* dn, unsigned int path);
+    void ReadAnimationClips();
+    void ReadChannels(domAnimation* anim, vector<domChannel*>& channels);
+    bool ReadChannel(domChannel* ch, ChannelSampler& cs);
+    static void SampleChannel(const ChannelSampler& cs, float t, float* out);
+    unsigned int BeginClip(PendingClip& pc);
+    unsigned int StepClip(PendingClip& pc, unsigned int budget);
+    void BeginTarget();
+    unsigned int BakeTracks();
+    void ReadNode(domNode* dNode, ISceneNode* sNode, unsigned int path);
     void ReadEffect(domInstance_effect* eInst, MaterialPtr m);
-    void ReadTriangles(domTriangles* ts, FaceSet* fs);
+    unsigned int ReadTriangles(domTriangles* ts, FaceSet* fs,
+                               unsigned int first, unsigned int count);
     void ReadColor(domCommon_color_or_texture_type_complexType* ct,
                               Vector<4,float>* dest);
     
@@ -111,6 +272,28 @@ public:
     void Load();
     void Unload();
     ISceneNode* GetSceneNode();
+
+    void BeginLoad();
+    bool Step(unsigned int budget);
+    bool IsLoaded();
+    void SetThreadCount(unsigned int threads);
+    void SetImportContext(ColladaImportContext* context);
+    void SetMessageQueue(vector<ColladaMessage>* queue);
+
+    void SetTangentGeneration(bool enable);
+    void SetCreaseAngle(float radians);
+    TangentList* GetTangents(FaceSet* fs);
+
+    void SetBatching(bool enable);
+    GeometryBatcher* GetBatcher();
+
+    void SetSkinWeightFormat(SkinWeightFormat format);
+    Skin* GetSkin(GeometryNode* node);
+
+    void SetAnimationSampleRate(float rate);
+    void SetAnimationTolerance(float position, float rotation);
+    unsigned int GetAnimationClipCount();
+    AnimationClip* GetAnimationClip(unsigned int i);
 };
 
 /**
@@ -119,9 +302,12 @@ public:
  * @class ColladaPlugin ColladaResource.h "ColladaResource.h"
  */
 class ColladaPlugin : public IResourcePlugin<IModelResource> {
+private:
+    ColladaImportContext* context;    //!< given to new resources, NULL if none
 public:
 	ColladaPlugin();
     IModelResourcePtr CreateResource(string file);
+    void SetImportContext(ColladaImportContext* context);
 };
 
 } // NS Resources
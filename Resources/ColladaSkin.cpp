@@ -0,0 +1,202 @@
+// Skinning data for imported meshes.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Resources/ColladaSkin.h>
+
+#include <algorithm>
+#include <functional>
+#include <cstring>
+
+namespace OpenEngine {
+namespace Resources {
+
+// definitions for uses that need an address, such as streaming
+const unsigned int Skin::MAX_INFLUENCES;
+const unsigned int Skin::MAX_JOINTS;
+
+/**
+ * Skin constructor.
+ *
+ * @param format Size of the encoded weights.
+ */
+Skin::Skin(SkinWeightFormat format)
+    : bindShapeMatrix(1,0,0,0,
+                      0,1,0,0,
+                      0,0,1,0,
+                      0,0,0,1),
+      format(format),
+      stride(MAX_INFLUENCES * (1 + format)),
+      dropped(0), truncated(0), unbound(0) {}
+
+/**
+ * Encode the variable length influence lists of a <vertex_weights>
+ * element into the fixed width vertex buffer. Influences of joints
+ * above MAX_JOINTS are dropped. Problems with the influences are
+ * counted rather than logged, as skins may be encoded on worker
+ * threads.
+ *
+ * @param vcount Number of influences for each mesh vertex.
+ * @param v Joint and weight index pairs for all influences.
+ * @param inputs Number of indices per influence in v.
+ * @param jointOffset Offset of the joint index in each influence.
+ * @param weightOffset Offset of the weight index in each influence.
+ * @param weights The weight source values.
+ * @param corners Mesh vertex index of each face corner.
+ */
+void Skin::Encode(const vector<unsigned int>& vcount, const vector<int>& v,
+                  unsigned int inputs, unsigned int jointOffset, unsigned int weightOffset,
+                  const vector<float>& weights, const vector<unsigned int>& corners) {
+    const unsigned int max = format == SKIN_WEIGHTS_8 ? 0xFF : 0xFFFF;
+    unsigned int jointCount = jointNames.size();
+    dropped = truncated = unbound = 0;
+
+    // encode each mesh vertex once
+    vector<unsigned char> encoded(vcount.size() * stride, 0);
+    unsigned int pos = 0;
+    for (unsigned int i = 0; i < vcount.size(); i++) {
+        vector<pair<float, unsigned int> > infl;
+        for (unsigned int k = 0; k < vcount[i]; k++, pos += inputs) {
+            if (pos + inputs > v.size()) {
+                dropped++;
+                continue;
+            }
+            int j = v[pos + jointOffset];
+            int w = v[pos + weightOffset];
+            // joint -1 refers to the bind shape and carries no joint
+            if (j < 0 || (unsigned int)j >= jointCount || (unsigned int)j >= MAX_JOINTS ||
+                w < 0 || (unsigned int)w >= weights.size()) {
+                dropped++;
+                continue;
+            }
+            if (weights[w] > 0.0f)
+                infl.push_back(make_pair(weights[w], (unsigned int)j));
+        }
+
+        sort(infl.begin(), infl.end(), greater<pair<float, unsigned int> >());
+        if (infl.size() > MAX_INFLUENCES) {
+            infl.resize(MAX_INFLUENCES);
+            truncated++;
+        }
+        if (infl.empty()) {
+            infl.push_back(make_pair(1.0f, 0u));
+            unbound++;
+        }
+
+        // renormalize and quantize, the rounding error goes to the
+        // largest weight so the weights sum to exactly one.
+        float sum = 0.0;
+        for (unsigned int k = 0; k < infl.size(); k++)
+            sum += infl[k].first;
+        unsigned int q[MAX_INFLUENCES] = {0, 0, 0, 0};
+        unsigned int total = 0;
+        for (unsigned int k = 0; k < infl.size(); k++) {
+            q[k] = (unsigned int)(infl[k].first / sum * max + 0.5f);
+            total += q[k];
+        }
+        q[0] = q[0] + max - total;
+
+        unsigned char* dest = &encoded[i * stride];
+        for (unsigned int k = 0; k < infl.size(); k++) {
+            dest[k] = (unsigned char)infl[k].second;
+            WriteWeight(dest, k, q[k]);
+        }
+    }
+
+    // expand to the face corners
+    vertices.resize(corners.size() * stride);
+    for (unsigned int c = 0; c < corners.size(); c++) {
+        unsigned char* dest = &vertices[c * stride];
+        if (corners[c] < vcount.size())
+            memcpy(dest, &encoded[corners[c] * stride], stride);
+        else {
+            memset(dest, 0, stride);
+            WriteWeight(dest, 0, max);
+            unbound++;
+        }
+    }
+}
+
+/**
+ * Number of invalid influences dropped by the last Encode().
+ */
+unsigned int Skin::GetDroppedInfluences() {
+    return dropped;
+}
+
+/**
+ * Number of mesh vertices that had more than MAX_INFLUENCES
+ * influences in the last Encode().
+ */
+unsigned int Skin::GetTruncatedVertices() {
+    return truncated;
+}
+
+/**
+ * Number of vertices without influences in the last Encode(). They
+ * are bound to the first joint.
+ */
+unsigned int Skin::GetUnboundVertices() {
+    return unbound;
+}
+
+void Skin::WriteWeight(unsigned char* dest, unsigned int i, unsigned int w) {
+    if (format == SKIN_WEIGHTS_8)
+        dest[MAX_INFLUENCES + i] = (unsigned char)w;
+    else {
+        unsigned short s = (unsigned short)w;
+        memcpy(dest + MAX_INFLUENCES + i * 2, &s, 2);
+    }
+}
+
+SkinWeightFormat Skin::GetFormat() {
+    return format;
+}
+
+/**
+ * Size of a vertex entry in bytes.
+ */
+unsigned int Skin::GetStride() {
+    return stride;
+}
+
+/**
+ * Number of vertex entries, three per face.
+ */
+unsigned int Skin::GetVertexCount() {
+    return vertices.size() / stride;
+}
+
+/**
+ * The encoded vertex buffer, ready for upload.
+ */
+const unsigned char* Skin::GetVertexData() {
+    return vertices.empty() ? NULL : &vertices[0];
+}
+
+unsigned char Skin::GetJoint(unsigned int vertex, unsigned int i) {
+    return vertices[vertex * stride + i];
+}
+
+/**
+ * Decode a weight.
+ *
+ * @param vertex Vertex entry index.
+ * @param i Influence index, less than MAX_INFLUENCES.
+ */
+float Skin::GetWeight(unsigned int vertex, unsigned int i) {
+    const unsigned char* src = &vertices[vertex * stride + MAX_INFLUENCES];
+    if (format == SKIN_WEIGHTS_8)
+        return src[i] / 255.0f;
+    unsigned short s;
+    memcpy(&s, src + i * 2, 2);
+    return s / 65535.0f;
+}
+
+} // NS Resources
+} // NS OpenEngine
@@ -0,0 +1,89 @@
+// Skinning data for imported meshes.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _COLLADA_SKIN_H_
+#define _COLLADA_SKIN_H_
+
+#include <Math/Matrix.h>
+
+#include <string>
+#include <vector>
+
+namespace OpenEngine {
+    namespace Scene {
+        class ISceneNode;
+    }
+
+namespace Resources {
+
+using OpenEngine::Scene::ISceneNode;
+using OpenEngine::Math::Matrix;
+using namespace std;
+
+//! Size of each encoded skin weight in bytes.
+enum SkinWeightFormat {
+    SKIN_WEIGHTS_8  = 1,
+    SKIN_WEIGHTS_16 = 2
+};
+
+/**
+ * Skinning data for a mesh in a fixed width, GPU ready encoding.
+ *
+ * Each face corner of the skinned face set has one entry of Stride()
+ * bytes in the vertex buffer, in FaceSet iteration order. An entry
+ * holds four 8 bit joint indices followed by four unsigned normalized
+ * weights of 8 or 16 bits (in host byte order). Influences are sorted
+ * by weight, at most four are kept and the quantized weights always
+ * sum to exactly one. Unused influences have joint 0 and weight 0.
+ *
+ * Matrices are stored in row vector form, like the matrices of the
+ * transformation nodes.
+ *
+ * @class Skin ColladaSkin.h "ColladaSkin.h"
+ */
+class Skin {
+public:
+    static const unsigned int MAX_INFLUENCES = 4;
+    static const unsigned int MAX_JOINTS = 256;
+
+    vector<string> jointNames;                     //!< joint sids or ids
+    vector<ISceneNode*> joints;                    //!< resolved joint nodes, NULL if unresolved
+    vector<Matrix<4,4,float> > inverseBindMatrices;
+    Matrix<4,4,float> bindShapeMatrix;
+
+    Skin(SkinWeightFormat format);
+
+    void Encode(const vector<unsigned int>& vcount, const vector<int>& v,
+                unsigned int inputs, unsigned int jointOffset, unsigned int weightOffset,
+                const vector<float>& weights, const vector<unsigned int>& corners);
+    unsigned int GetDroppedInfluences();
+    unsigned int GetTruncatedVertices();
+    unsigned int GetUnboundVertices();
+
+    SkinWeightFormat GetFormat();
+    unsigned int GetStride();
+    unsigned int GetVertexCount();
+    const unsigned char* GetVertexData();
+
+    unsigned char GetJoint(unsigned int vertex, unsigned int i);
+    float GetWeight(unsigned int vertex, unsigned int i);
+
+private:
+    SkinWeightFormat format;
+    unsigned int stride;
+    vector<unsigned char> vertices;
+    unsigned int dropped, truncated, unbound; //!< problems found by Encode()
+
+    void WriteWeight(unsigned char* dest, unsigned int i, unsigned int w);
+};
+
+} // NS Resources
+} // NS OpenEngine
+
+#endif // _COLLADA_SKIN_H_
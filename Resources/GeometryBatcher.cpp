@@ -0,0 +1,349 @@
+// Material sorted batching of imported geometry.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Resources/GeometryBatcher.h>
+#include <Resources/ColladaMath.h>
+
+#include <Geometry/Face.h>
+#include <Geometry/FaceSet.h>
+#include <Geometry/Material.h>
+#include <Scene/GeometryNode.h>
+#include <Scene/ISceneNode.h>
+#include <Scene/TransformationNode.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace OpenEngine {
+namespace Resources {
+
+using namespace ColladaMath;
+
+bool GeometryBatcher::Key::operator<(const Key& k) const {
+    if (mat != k.mat) return mat < k.mat;
+    if (tangents != k.tangents) return tangents < k.tangents;
+    for (int i = 0; i < 3; i++)
+        if (cell[i] != k.cell[i]) return cell[i] < k.cell[i];
+    return false;
+}
+
+// Order batches by their key, which keeps batches of the same
+// material next to each other.
+struct BatchLess {
+    template <class T>
+    bool operator()(const T* a, const T* b) const {
+        return a->key < b->key;
+    }
+};
+
+/**
+ * Batcher constructor.
+ * Defaults to no spatial splitting and a budget of 65535 vertices
+ * per batch, so batches can be drawn with 16 bit indices.
+ */
+GeometryBatcher::GeometryBatcher()
+    : regionSize(0.0), maxVertices(65535), srcTangents(NULL), failedFaces(0) {}
+
+GeometryBatcher::~GeometryBatcher() {
+    Clear();
+}
+
+/**
+ * Set the side length of the grid cells used to split batches
+ * spatially. A size of zero or less disables spatial splitting.
+ */
+void GeometryBatcher::SetRegionSize(float size) {
+    regionSize = size;
+}
+
+/**
+ * Set the maximum number of vertices in a single batch.
+ */
+void GeometryBatcher::SetMaxVertices(unsigned int vertices) {
+    maxVertices = vertices < 3 ? 3 : vertices;
+}
+
+/**
+ * Exclude a subtree from batching, eg. because it is animated.
+ */
+void GeometryBatcher::Exclude(ISceneNode* node) {
+    excluded.insert(node);
+}
+
+/**
+ * Batch all static geometry below root.
+ *
+ * The batches are added as geometry nodes directly below root and
+ * the source geometry nodes are removed from the scene. Tangent lists
+ * of the sources are transformed along with the faces and the lists
+ * for the new batches are added to the tangent map.
+ *
+ * @param root Root of the scene to batch. Its own transformation is
+ *             not baked into the batches.
+ * @param tangents Tangent lists by face set.
+ */
+void GeometryBatcher::Batch(ISceneNode* root, map<FaceSet*, TangentListPtr>& tangents) {
+    ClearResult();
+    srcTangents = &tangents;
+    stack.push_back(Matrix<4,4,float>(1,0,0,0,
+                                      0,1,0,0,
+                                      0,0,1,0,
+                                      0,0,0,1));
+    parents.push_back(root);
+    root->VisitSubNodes(*this);
+    stack.clear();
+    parents.clear();
+    open.clear();
+    srcTangents = NULL;
+
+    // detach the sources, they are kept for picking
+    set<GeometryNode*> detached;
+    for (unsigned int i = 0; i < batches.size(); i++) {
+        vector<BatchRange>& ranges = batches[i]->ranges;
+        for (unsigned int r = 0; r < ranges.size(); r++) {
+            if (detached.insert(ranges[r].source).second) {
+                ranges[r].parent->RemoveNode(ranges[r].source);
+                sources.push_back(ranges[r].source);
+            }
+        }
+    }
+
+    // attach the batches sorted by material
+    stable_sort(batches.begin(), batches.end(), BatchLess());
+    for (unsigned int i = 0; i < batches.size(); i++) {
+        BatchData* b = batches[i];
+        b->node = new GeometryNode(b->fs);
+        root->AddNode(b->node);
+        lookup[b->node] = b;
+        if (b->tangents != NULL)
+            tangents[b->fs] = TangentListPtr(b->tangents);
+    }
+}
+
+/**
+ * Forget the result of the last batching pass and all exclusions.
+ * The detached source nodes are deleted. The batches themselves
+ * belong to the scene graph.
+ */
+void GeometryBatcher::Clear() {
+    ClearResult();
+    excluded.clear();
+}
+
+void GeometryBatcher::ClearResult() {
+    for (vector<BatchData*>::iterator itr = batches.begin(); itr != batches.end(); itr++)
+        delete *itr;
+    batches.clear();
+    lookup.clear();
+    for (vector<GeometryNode*>::iterator itr = sources.begin(); itr != sources.end(); itr++)
+        delete *itr;
+    sources.clear();
+    failedFaces = 0;
+}
+
+unsigned int GeometryBatcher::GetBatchCount() {
+    return batches.size();
+}
+
+/**
+ * Number of geometry nodes merged into batches by the last pass.
+ */
+unsigned int GeometryBatcher::GetSourceCount() {
+    return sources.size();
+}
+
+/**
+ * Number of faces the last pass failed to transform. They are left
+ * out of the batches.
+ */
+unsigned int GeometryBatcher::GetFailedFaceCount() {
+    return failedFaces;
+}
+
+GeometryNode* GeometryBatcher::GetBatch(unsigned int i) {
+    return batches[i]->node;
+}
+
+/**
+ * Get the source ranges of a batch, ordered by first face.
+ *
+ * @return The ranges or NULL if the node is not a batch.
+ */
+const vector<BatchRange>* GeometryBatcher::GetRanges(GeometryNode* batch) {
+    map<GeometryNode*, BatchData*>::iterator itr = lookup.find(batch);
+    if (itr == lookup.end())
+        return NULL;
+    return &itr->second->ranges;
+}
+
+/**
+ * Map a face in a batch back to the geometry node it came from.
+ *
+ * @param batch Batch geometry node.
+ * @param face Index of the face in the batch face set.
+ * @return The source node or NULL if not found.
+ */
+GeometryNode* GeometryBatcher::GetSourceNode(GeometryNode* batch, unsigned int face) {
+    const vector<BatchRange>* ranges = GetRanges(batch);
+    if (ranges == NULL)
+        return NULL;
+
+    // binary search for the last range starting at or before face
+    unsigned int lo = 0, hi = ranges->size();
+    while (lo < hi) {
+        unsigned int mid = (lo + hi) / 2;
+        if ((*ranges)[mid].firstFace <= face)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0)
+        return NULL;
+    const BatchRange& r = (*ranges)[lo-1];
+    if (face >= r.firstFace + r.faceCount)
+        return NULL;
+    return r.source;
+}
+
+void GeometryBatcher::VisitTransformationNode(TransformationNode* node) {
+    if (excluded.find(node) != excluded.end())
+        return;
+    stack.push_back(node->GetTransformationMatrix() * stack.back());
+    parents.push_back(node);
+    node->VisitSubNodes(*this);
+    parents.pop_back();
+    stack.pop_back();
+}
+
+void GeometryBatcher::VisitGeometryNode(GeometryNode* node) {
+    if (excluded.find(node) != excluded.end())
+        return;
+    AddGeometry(node, parents.back(), stack.back());
+}
+
+/**
+ * Transform the faces of a geometry node and append them to the
+ * batches matching their material and region.
+ */
+void GeometryBatcher::AddGeometry(GeometryNode* node, ISceneNode* parent,
+                                  const Matrix<4,4,float>& m) {
+    FaceSet* fs = node->GetFaceSet();
+    if (fs == NULL)
+        return;
+
+    TangentList* tl = NULL;
+    map<FaceSet*, TangentListPtr>::const_iterator titr = srcTangents->find(fs);
+    if (titr != srcTangents->end())
+        tl = titr->second.get();
+
+    // the transformation uses row vectors: p' = p * L + t
+    Vector<3,float> row[3], trans(m(3,0), m(3,1), m(3,2));
+    for (int i = 0; i < 3; i++)
+        row[i] = Vector<3,float>(m(i,0), m(i,1), m(i,2));
+
+    // normals are transformed by the cofactor matrix
+    Vector<3,float> cof[3];
+    cof[0] = Cross(row[1], row[2]);
+    cof[1] = Cross(row[2], row[0]);
+    cof[2] = Cross(row[0], row[1]);
+    float det = Dot(row[0], cof[0]);
+    float nSign = det < 0.0f ? -1.0f : 1.0f;
+
+    // mirroring transformations flip the winding
+    const unsigned int order[2][3] = {{0,1,2}, {0,2,1}};
+    const unsigned int* o = order[det < 0.0f ? 1 : 0];
+
+    unsigned int index = 0;
+    for (FaceList::iterator itr = fs->begin(); itr != fs->end(); itr++, index++) {
+        Face* src = (*itr).get();
+        Vector<3,float> v[3], n[3];
+        for (int c = 0; c < 3; c++) {
+            const Vector<3,float>& p = src->vert[o[c]];
+            v[c] = row[0] * p[0] + row[1] * p[1] + row[2] * p[2] + trans;
+            const Vector<3,float>& sn = src->norm[o[c]];
+            n[c] = (cof[0] * sn[0] + cof[1] * sn[1] + cof[2] * sn[2]) * nSign;
+            Normalize(n[c]);
+        }
+
+        Key key;
+        key.mat = src->mat.get();
+        key.tangents = tl != NULL;
+        for (int i = 0; i < 3; i++) {
+            key.cell[i] = 0;
+            if (regionSize > 0.0f)
+                key.cell[i] = (int)floor((v[0][i] + v[1][i] + v[2][i]) / (3.0f * regionSize));
+        }
+
+        FacePtr face;
+        try {
+            face = FacePtr(new Face(v[0], v[1], v[2], n[0], n[1], n[2]));
+        }
+        catch (Exception e) {
+            failedFaces++;
+            continue;
+        }
+        for (int c = 0; c < 3; c++) {
+            face->texc[c] = src->texc[o[c]];
+            face->colr[c] = src->colr[o[c]];
+        }
+        face->mat = src->mat;
+
+        // find an open batch with room for the face
+        BatchData* b = NULL;
+        map<Key, BatchData*>::iterator bitr = open.find(key);
+        if (bitr != open.end() && bitr->second->vertices + 3 <= maxVertices)
+            b = bitr->second;
+        else {
+            b = new BatchData();
+            b->key = key;
+            b->fs = new FaceSet();
+            b->tangents = tl != NULL ? new TangentList() : NULL;
+            b->vertices = 0;
+            b->node = NULL;
+            batches.push_back(b);
+            open[key] = b;
+        }
+
+        unsigned int faceIndex = b->vertices / 3;
+        b->fs->Add(face);
+        b->vertices += 3;
+
+        if (tl != NULL) {
+            const FaceTangents& st = (*tl)[index];
+            FaceTangents dt;
+            for (int c = 0; c < 3; c++) {
+                const Vector<4,float>& t4 = st.tangent[o[c]];
+                Vector<3,float> t = row[0] * t4[0] + row[1] * t4[1] + row[2] * t4[2];
+                const Vector<3,float>& sb = st.bitangent[o[c]];
+                Vector<3,float> bt = row[0] * sb[0] + row[1] * sb[1] + row[2] * sb[2];
+                Normalize(t);
+                float w = Dot(Cross(n[c], t), bt) < 0.0f ? -1.0f : 1.0f;
+                dt.tangent[c] = Vector<4,float>(t[0], t[1], t[2], w);
+                dt.bitangent[c] = Cross(n[c], t) * w;
+            }
+            b->tangents->push_back(dt);
+        }
+
+        // extend the current source range or start a new one
+        if (!b->ranges.empty() && b->ranges.back().source == node &&
+            b->ranges.back().firstFace + b->ranges.back().faceCount == faceIndex)
+            b->ranges.back().faceCount++;
+        else {
+            BatchRange r;
+            r.source = node;
+            r.parent = parent;
+            r.firstFace = faceIndex;
+            r.faceCount = 1;
+            b->ranges.push_back(r);
+        }
+    }
+}
+
+} // NS Resources
+} // NS OpenEngine
@@ -0,0 +1,125 @@
+// Material sorted batching of imported geometry.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _GEOMETRY_BATCHER_H_
+#define _GEOMETRY_BATCHER_H_
+
+#include <Resources/TangentSpaceGenerator.h>
+#include <Scene/ISceneNodeVisitor.h>
+#include <Math/Matrix.h>
+
+#include <vector>
+#include <map>
+#include <set>
+
+namespace OpenEngine {
+    namespace Scene {
+        class ISceneNode;
+        class GeometryNode;
+        class TransformationNode;
+    }
+    namespace Geometry {
+        class FaceSet;
+        class Material;
+    }
+
+namespace Resources {
+
+using namespace OpenEngine::Scene;
+using namespace OpenEngine::Geometry;
+using OpenEngine::Math::Matrix;
+using namespace std;
+
+/**
+ * A run of faces in a batch originating from one source node.
+ */
+struct BatchRange {
+    GeometryNode* source;    //!< the geometry node the faces came from
+    ISceneNode* parent;      //!< the node the source was attached to
+    unsigned int firstFace;  //!< index of the first face in the batch
+    unsigned int faceCount;  //!< number of consecutive faces
+};
+
+/**
+ * Merges static geometry sharing the same material into large,
+ * pre-transformed face sets.
+ *
+ * All geometry nodes below the given root (except those in excluded
+ * subtrees) are transformed into the space of the root, grouped by
+ * material and optionally by a uniform grid of regions, and written
+ * into batches that never exceed the vertex budget. The source
+ * geometry nodes are detached from the scene, but kept alive so that
+ * a face in a batch can be mapped back to its source for picking.
+ *
+ * @class GeometryBatcher GeometryBatcher.h "GeometryBatcher.h"
+ */
+class GeometryBatcher : public ISceneNodeVisitor {
+private:
+    struct Key {
+        Material* mat;
+        bool tangents;
+        int cell[3];
+        bool operator<(const Key& k) const;
+    };
+
+    struct BatchData {
+        Key key;
+        FaceSet* fs;
+        TangentList* tangents;
+        unsigned int vertices;
+        vector<BatchRange> ranges;
+        GeometryNode* node;
+    };
+
+    float regionSize;
+    unsigned int maxVertices;
+    set<ISceneNode*> excluded;
+
+    // traversal state
+    vector<Matrix<4,4,float> > stack;
+    vector<ISceneNode*> parents;
+    const map<FaceSet*, TangentListPtr>* srcTangents;
+    map<Key, BatchData*> open;
+
+    // result, batches are sorted by material once the pass is done
+    vector<BatchData*> batches;
+    map<GeometryNode*, BatchData*> lookup;
+    vector<GeometryNode*> sources;
+    unsigned int failedFaces;
+
+    void AddGeometry(GeometryNode* node, ISceneNode* parent,
+                     const Matrix<4,4,float>& m);
+    void ClearResult();
+
+public:
+    GeometryBatcher();
+    virtual ~GeometryBatcher();
+
+    void SetRegionSize(float size);
+    void SetMaxVertices(unsigned int vertices);
+    void Exclude(ISceneNode* node);
+
+    void Batch(ISceneNode* root, map<FaceSet*, TangentListPtr>& tangents);
+    void Clear();
+
+    unsigned int GetBatchCount();
+    unsigned int GetSourceCount();
+    unsigned int GetFailedFaceCount();
+    GeometryNode* GetBatch(unsigned int i);
+    const vector<BatchRange>* GetRanges(GeometryNode* batch);
+    GeometryNode* GetSourceNode(GeometryNode* batch, unsigned int face);
+
+    void VisitTransformationNode(TransformationNode* node);
+    void VisitGeometryNode(GeometryNode* node);
+};
+
+} // NS Resources
+} // NS OpenEngine
+
+#endif // _GEOMETRY_BATCHER_H_
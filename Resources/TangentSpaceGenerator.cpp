@@ -0,0 +1,886 @@
+// Normal and tangent space generation for imported meshes.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Resources/TangentSpaceGenerator.h>
+#include <Resources/ColladaJobQueue.h>
+#include <Resources/ColladaMath.h>
+
+#include <Geometry/Face.h>
+#include <Geometry/FaceSet.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <map>
+
+namespace OpenEngine {
+namespace Resources {
+
+using namespace ColladaMath;
+
+// Strict ordering on positions used for welding.
+struct PositionLess {
+    bool operator()(const Vector<3,float>& a, const Vector<3,float>& b) const {
+        if (a[0] != b[0]) return a[0] < b[0];
+        if (a[1] != b[1]) return a[1] < b[1];
+        return a[2] < b[2];
+    }
+};
+
+//! Full vertex as seen by MikkTSpace.
+struct MikkVertex {
+    Vector<3,float> pos;
+    Vector<3,float> norm;
+    Vector<2,float> texc;
+};
+
+// Strict ordering on full vertices used for welding.
+struct MikkVertexLess {
+    bool operator()(const MikkVertex& a, const MikkVertex& b) const {
+        PositionLess less;
+        if (less(a.pos, b.pos)) return true;
+        if (less(b.pos, a.pos)) return false;
+        if (less(a.norm, b.norm)) return true;
+        if (less(b.norm, a.norm)) return false;
+        if (a.texc[0] != b.texc[0]) return a.texc[0] < b.texc[0];
+        return a.texc[1] < b.texc[1];
+    }
+};
+
+// The vector helpers of MikkTSpace, written out so the float
+// operations happen in the same order as in the reference.
+
+static inline bool NotZero(float f) {
+    return std::fabs(f) > FLT_MIN;
+}
+
+static inline bool VNotZero(const Vector<3,float>& v) {
+    return NotZero(v[0]) || NotZero(v[1]) || NotZero(v[2]);
+}
+
+static inline Vector<3,float> VScale(float s, const Vector<3,float>& v) {
+    return Vector<3,float>(s * v[0], s * v[1], s * v[2]);
+}
+
+static inline Vector<3,float> VAdd(const Vector<3,float>& a, const Vector<3,float>& b) {
+    return Vector<3,float>(a[0] + b[0], a[1] + b[1], a[2] + b[2]);
+}
+
+static inline Vector<3,float> VSub(const Vector<3,float>& a, const Vector<3,float>& b) {
+    return Vector<3,float>(a[0] - b[0], a[1] - b[1], a[2] - b[2]);
+}
+
+static inline float VLength(const Vector<3,float>& v) {
+    return std::sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+}
+
+static inline Vector<3,float> VNormalize(const Vector<3,float>& v) {
+    return VScale(1 / VLength(v), v);
+}
+
+// Remove the part of v along the unit vector n and normalize the rest
+// if anything is left.
+static inline Vector<3,float> VProject(const Vector<3,float>& v, const Vector<3,float>& n) {
+    Vector<3,float> p = VSub(v, VScale(Dot(n, v), n));
+    return VNotZero(p) ? VNormalize(p) : p;
+}
+
+static const unsigned int NO_CORNER = UINT_MAX;
+static const unsigned int NO_FACE = UINT_MAX;
+static const unsigned int NO_GROUP = UINT_MAX;
+
+//! Triangle flags, as in the reference.
+enum {
+    MARK_DEGENERATE = 1,
+    GROUP_WITH_ANY = 4,
+    ORIENT_PRESERVING = 8
+};
+
+//! The MikkTSpace angular threshold of 180 degrees.
+static const float THRES_COS = -1.0f;
+
+/**
+ * Working data for a single face set.
+ * Corners are indexed as 3 * face + vertex.
+ */
+struct TangentSpaceGenerator::Mesh {
+    //! Passes over the faces, in the order they are run.
+    enum Phase {
+        PHASE_WELD,
+        PHASE_NORMALS,
+        PHASE_TRIANGLES,
+        PHASE_EDGES,
+        PHASE_GROUPS,
+        PHASE_SPACES,
+        PHASE_TANGENTS,
+        PHASE_DONE
+    };
+
+    //! Triangle data of MikkTSpace.
+    struct Triangle {
+        int flags;
+        unsigned int neighbour[3];    //!< face across the edge from corner i to i+1
+        unsigned int group[3];        //!< group of each corner
+        Vector<3,float> os, ot;       //!< unit tangent and bitangent in uv direction
+        float magS, magT;
+    };
+
+    //! Triangles sharing a vertex and orientation.
+    struct Group {
+        unsigned int vertex;          //!< welded vertex shared by the faces
+        bool orient;                  //!< orientation preserving
+        unsigned int first, count;    //!< faces in groupFaces
+    };
+
+    //! Tangent space of a sub group.
+    struct SubGroup {
+        vector<unsigned int> faces;   //!< sorted member faces
+        Vector<3,float> os;
+    };
+
+    //! Tangent space of a corner.
+    struct Space {
+        Vector<3,float> os;
+        bool orient;
+    };
+
+    FaceSet* fs;
+    vector<bool> genNormals;          //!< per face, true if normals must be generated
+    TangentList* tangents;            //!< output tangents, NULL if not wanted
+
+    Phase phase;
+    unsigned int faceCount;
+    unsigned int total;               //!< units of work in this phase
+    unsigned int cursor;              //!< units handed out in this phase
+    unsigned int work;                //!< units done by the last step
+    FaceList::iterator next;          //!< next face to weld
+
+    // smoothing of normals
+    vector<Face*> faces;
+    map<Vector<3,float>, unsigned int, PositionLess> positions; //!< only kept while welding
+    vector<unsigned int> corner;      //!< welded position index of each corner
+    vector<unsigned int> first;       //!< per position first corner
+    vector<unsigned int> link;        //!< per corner next corner at the same position
+    vector<float> angle;              //!< corner angles used as weights
+    vector<Vector<3,float> > faceNorm;
+    vector<Vector<3,float> > cornerNorm; //!< final normal of each corner
+
+    // tangent spaces
+    map<MikkVertex, unsigned int, MikkVertexLess> vertices; //!< only kept while reading triangles
+    vector<unsigned int> vertex;      //!< welded vertex index of each corner
+    vector<unsigned int> firstGood;   //!< per vertex first corner of a good triangle
+    vector<Triangle> tris;
+    map<pair<unsigned int, unsigned int>, vector<unsigned int> > edges; //!< faces by edge, only kept while pairing
+    map<pair<unsigned int, unsigned int>, vector<unsigned int> >::iterator edge; //!< next edge to pair
+    vector<Group> groups;
+    vector<unsigned int> groupFaces;  //!< faces of all groups, one group after the other
+    vector<unsigned int> stack;       //!< faces left to visit while building a group
+    unsigned int group;               //!< group being evaluated
+    unsigned int member;              //!< next entry of groupFaces to evaluate
+    vector<SubGroup> subGroups;       //!< sub groups of the group being evaluated
+    vector<Space> spaces;             //!< tangent space of each corner
+};
+
+class TangentSpaceGenerator::PhaseJob : public ColladaJobQueue::Job {
+    Mesh* m;
+    unsigned int budget;
+public:
+    PhaseJob(Mesh* m, unsigned int budget)
+        : m(m), budget(budget) {}
+    void Execute() { TangentSpaceGenerator::RunPhase(m, budget); }
+};
+
+class TangentSpaceGenerator::ChunkJob : public ColladaJobQueue::Job {
+    Mesh* m;
+    float cosCrease;
+    unsigned int begin, end;
+public:
+    ChunkJob(Mesh* m, float cosCrease, unsigned int begin, unsigned int end)
+        : m(m), cosCrease(cosCrease), begin(begin), end(end) {}
+    void Execute() { TangentSpaceGenerator::RunChunk(m, cosCrease, begin, end); }
+};
+
+/**
+ * Generator constructor.
+ * Defaults to a crease angle of 60 degrees, chunks of 4096 faces
+ * and four worker threads.
+ */
+TangentSpaceGenerator::TangentSpaceGenerator()
+    : cosCrease(0.5f), chunkSize(4096), threads(4) {}
+
+TangentSpaceGenerator::~TangentSpaceGenerator() {
+    for (vector<Mesh*>::iterator itr = meshes.begin(); itr != meshes.end(); itr++)
+        delete *itr;
+}
+
+/**
+ * Set the maximum angle between two faces that are smoothed together.
+ *
+ * @param radians Crease angle in radians.
+ */
+void TangentSpaceGenerator::SetCreaseAngle(float radians) {
+    cosCrease = cos(radians);
+}
+
+/**
+ * Set the number of faces processed by each job when generating
+ * per vertex data.
+ */
+void TangentSpaceGenerator::SetChunkSize(unsigned int faces) {
+    chunkSize = faces > 0 ? faces : 1;
+}
+
+/**
+ * Set the maximum number of worker threads.
+ */
+void TangentSpaceGenerator::SetThreadCount(unsigned int threads) {
+    this->threads = threads > 0 ? threads : 1;
+}
+
+/**
+ * Schedule a face set for processing.
+ * Nothing is done until Step() or Run() is called. The face set
+ * must not change until it has been processed.
+ *
+ * @param fs Face set to process.
+ * @param genNormals Per face flags, in FaceSet iteration order,
+ *                   telling which faces need generated normals.
+ * @param tangents List to receive the tangent frames or NULL.
+ */
+void TangentSpaceGenerator::AddMesh(FaceSet* fs, const vector<bool>& genNormals,
+                                    TangentList* tangents) {
+    bool any = false;
+    for (unsigned int i = 0; i < genNormals.size() && !any; i++)
+        any = genNormals[i];
+    if (!any && tangents == NULL)
+        return;
+
+    Mesh* m = new Mesh();
+    m->fs = fs;
+    m->genNormals = genNormals;
+    m->tangents = tangents;
+    m->phase = Mesh::PHASE_WELD;
+    m->faceCount = fs->Size();
+    m->total = m->faceCount;
+    m->cursor = 0;
+    meshes.push_back(m);
+}
+
+/**
+ * Process at most about the given amount of work.
+ *
+ * Every face is visited once to weld positions and once to compute
+ * normals. For tangents every face is visited once to weld its
+ * vertices, once per edge to find its neighbours, once per corner to
+ * group it, once per face of each of its groups to evaluate tangent
+ * spaces and finally once to write them. Each visit counts as one
+ * unit of work. The work of a step is spread over the scheduled
+ * meshes, the passes over single faces are split into chunks for the
+ * worker threads, and a mesh is resumed where the previous step left
+ * it. A step may overrun the budget by the faces of one edge or group.
+ *
+ * @param budget Maximum amount of work to do.
+ * @return Amount of work done, zero if there was nothing to do.
+ */
+unsigned int TangentSpaceGenerator::Step(unsigned int budget) {
+    if (budget == 0) budget = 1;
+    unsigned int work = 0;
+    while (work < budget && !meshes.empty()) {
+        // hand out the rest of the budget to the meshes in order
+        ColladaJobQueue jobs;
+        unsigned int planned = work;
+        unsigned int scheduled = 0;
+        for (; scheduled < meshes.size() && planned < budget; scheduled++) {
+            Mesh* m = meshes[scheduled];
+            if (m->phase == Mesh::PHASE_WELD && m->cursor == 0)
+                Prepare(m);
+            unsigned int begin = m->cursor;
+            unsigned int count = m->total - begin;
+            if (count > budget - planned)
+                count = budget - planned;
+            planned += count > 0 ? count : 1;
+
+            // passes that link faces are sequential within a mesh
+            if (!IsChunked(m)) {
+                jobs.Add(new PhaseJob(m, count));
+                continue;
+            }
+            for (unsigned int b = begin; b < begin + count; b += chunkSize) {
+                unsigned int e = b + chunkSize < begin + count ? b + chunkSize : begin + count;
+                jobs.Add(new ChunkJob(m, cosCrease, b, e));
+            }
+            m->cursor += count;
+            m->work = count;
+        }
+        jobs.Run(threads);
+        for (unsigned int i = 0; i < scheduled; i++)
+            work += meshes[i]->work > 0 ? meshes[i]->work : 1;
+
+        // move the meshes that are through a phase on to the next,
+        // each phase needs the complete result of the one before
+        vector<Mesh*>::iterator itr = meshes.begin();
+        while (itr != meshes.end()) {
+            Mesh* m = *itr;
+            if (m->cursor >= m->total)
+                Advance(m);
+            if (m->phase == Mesh::PHASE_DONE) {
+                delete m;
+                itr = meshes.erase(itr);
+            }
+            else
+                itr++;
+        }
+    }
+    return work;
+}
+
+/**
+ * Check if all scheduled face sets have been processed.
+ */
+bool TangentSpaceGenerator::IsDone() {
+    return meshes.empty();
+}
+
+/**
+ * Process all scheduled face sets and wait for the result.
+ */
+void TangentSpaceGenerator::Run() {
+    while (!IsDone())
+        Step(UINT_MAX);
+}
+
+/**
+ * Allocate the working data of a mesh before it is welded.
+ */
+void TangentSpaceGenerator::Prepare(Mesh* m) {
+    unsigned int faceCount = m->faceCount;
+    m->next = m->fs->begin();
+    m->faces.resize(faceCount);
+    m->genNormals.resize(faceCount, false);
+    m->corner.resize(faceCount * 3);
+    m->link.resize(faceCount * 3);
+    m->angle.resize(faceCount * 3);
+    m->cornerNorm.resize(faceCount * 3);
+    m->faceNorm.resize(faceCount);
+    if (m->tangents != NULL)
+        m->tangents->resize(faceCount);
+}
+
+/**
+ * Start the next phase of a mesh and free the data that is no longer
+ * needed.
+ */
+void TangentSpaceGenerator::Advance(Mesh* m) {
+    m->cursor = 0;
+    m->total = m->faceCount;
+    switch (m->phase) {
+    case Mesh::PHASE_WELD:
+        m->positions.clear();
+        m->phase = Mesh::PHASE_NORMALS;
+        break;
+    case Mesh::PHASE_NORMALS:
+        vector<unsigned int>().swap(m->corner);
+        vector<unsigned int>().swap(m->first);
+        vector<unsigned int>().swap(m->link);
+        vector<float>().swap(m->angle);
+        vector<Vector<3,float> >().swap(m->faceNorm);
+        if (m->tangents == NULL) {
+            m->phase = Mesh::PHASE_DONE;
+            break;
+        }
+        m->vertex.resize(m->faceCount * 3);
+        m->tris.resize(m->faceCount);
+        m->phase = Mesh::PHASE_TRIANGLES;
+        break;
+    case Mesh::PHASE_TRIANGLES:
+        m->vertices.clear();
+        m->edge = m->edges.begin();
+        m->total = 0;
+        for (unsigned int f = 0; f < m->faceCount; f++)
+            if ((m->tris[f].flags & MARK_DEGENERATE) == 0)
+                m->total += 3;
+        m->phase = Mesh::PHASE_EDGES;
+        break;
+    case Mesh::PHASE_EDGES:
+        m->edges.clear();
+        m->total = m->faceCount * 3;
+        m->phase = Mesh::PHASE_GROUPS;
+        break;
+    case Mesh::PHASE_GROUPS: {
+        vector<unsigned int>().swap(m->stack);
+        m->total = 0;
+        for (unsigned int g = 0; g < m->groups.size(); g++)
+            m->total += m->groups[g].count * m->groups[g].count;
+        Mesh::Space space;
+        space.os = Vector<3,float>(1.0,0.0,0.0);
+        space.orient = false;
+        m->spaces.resize(m->faceCount * 3, space);
+        m->group = 0;
+        m->member = 0;
+        m->phase = Mesh::PHASE_SPACES;
+        break;
+    }
+    case Mesh::PHASE_SPACES:
+        m->subGroups.clear();
+        m->phase = Mesh::PHASE_TANGENTS;
+        break;
+    default:
+        m->phase = Mesh::PHASE_DONE;
+    }
+}
+
+/**
+ * Check if the current phase of a mesh works on independent faces,
+ * such that it can be split into chunks.
+ */
+bool TangentSpaceGenerator::IsChunked(Mesh* m) {
+    return m->phase == Mesh::PHASE_NORMALS || m->phase == Mesh::PHASE_TANGENTS;
+}
+
+/**
+ * Run a sequential phase of a mesh for about the given amount of
+ * work, at least one unit if any is left.
+ */
+void TangentSpaceGenerator::RunPhase(Mesh* m, unsigned int budget) {
+    unsigned int begin = m->cursor;
+    unsigned int end = begin + (budget > 0 ? budget : 1);
+    if (end > m->total)
+        end = m->total;
+    switch (m->phase) {
+    case Mesh::PHASE_WELD:
+        Weld(m, begin, end);
+        m->cursor = end;
+        break;
+    case Mesh::PHASE_TRIANGLES:
+        ReadTriangles(m, begin, end);
+        m->cursor = end;
+        break;
+    case Mesh::PHASE_EDGES:
+        PairEdges(m, end);
+        break;
+    case Mesh::PHASE_GROUPS:
+        BuildGroups(m, end);
+        break;
+    case Mesh::PHASE_SPACES:
+        EvalSpaces(m, end);
+        break;
+    default:
+        break;
+    }
+    m->work = m->cursor - begin;
+}
+
+/**
+ * Run a chunked phase of a mesh for the faces in [begin;end).
+ */
+void TangentSpaceGenerator::RunChunk(Mesh* m, float cosCrease,
+                                     unsigned int begin, unsigned int end) {
+    if (m->phase == Mesh::PHASE_NORMALS)
+        ProcessNormals(m, cosCrease, begin, end);
+    else
+        WriteTangents(m, begin, end);
+}
+
+/**
+ * Weld positions and compute face normals for the faces in
+ * [begin;end) of a mesh. Faces must be welded in order.
+ */
+void TangentSpaceGenerator::Weld(Mesh* m, unsigned int begin, unsigned int end) {
+    for (unsigned int f = begin; f < end; f++, m->next++) {
+        Face* face = (*m->next).get();
+        m->faces[f] = face;
+
+        // weld identical positions and link the corners sharing them
+        for (unsigned int c = 0; c < 3; c++) {
+            const Vector<3,float>& v = face->vert[c];
+            unsigned int idx;
+            map<Vector<3,float>, unsigned int, PositionLess>::iterator itr = m->positions.find(v);
+            if (itr == m->positions.end()) {
+                idx = m->first.size();
+                m->positions[v] = idx;
+                m->first.push_back(NO_CORNER);
+            } else
+                idx = itr->second;
+            m->corner[f*3+c] = idx;
+            m->link[f*3+c] = m->first[idx];
+            m->first[idx] = f*3+c;
+        }
+
+        // face normal and corner angles
+        Vector<3,float> e1 = face->vert[1] - face->vert[0];
+        Vector<3,float> e2 = face->vert[2] - face->vert[0];
+        Vector<3,float> n = Cross(e1, e2);
+        if (!Normalize(n))
+            n = Vector<3,float>(0.0,0.0,0.0);
+        m->faceNorm[f] = n;
+
+        for (unsigned int c = 0; c < 3; c++) {
+            Vector<3,float> a = face->vert[(c+1)%3] - face->vert[c];
+            Vector<3,float> b = face->vert[(c+2)%3] - face->vert[c];
+            float w = 0.0;
+            if (Normalize(a) && Normalize(b)) {
+                float d = Dot(a,b);
+                if (d > 1.0f) d = 1.0f;
+                if (d < -1.0f) d = -1.0f;
+                w = acos(d);
+            }
+            m->angle[f*3+c] = w;
+        }
+    }
+}
+
+/**
+ * Compute the normals of the corners of faces in [begin;end). Only
+ * data belonging to these faces is written.
+ */
+void TangentSpaceGenerator::ProcessNormals(Mesh* m, float cosCrease,
+                                           unsigned int begin, unsigned int end) {
+    for (unsigned int f = begin; f < end; f++) {
+        Face* face = m->faces[f];
+        for (unsigned int c = 0; c < 3; c++) {
+            unsigned int p = m->corner[f*3+c];
+
+            // smooth normal over the faces within the crease angle
+            Vector<3,float> n = face->norm[c];
+            if (m->genNormals[f]) {
+                n = Vector<3,float>(0.0,0.0,0.0);
+                for (unsigned int k = m->first[p]; k != NO_CORNER; k = m->link[k]) {
+                    const Vector<3,float>& fn = m->faceNorm[k/3];
+                    if (Dot(m->faceNorm[f], fn) >= cosCrease)
+                        n = n + fn * m->angle[k];
+                }
+                if (!Normalize(n))
+                    n = m->faceNorm[f];
+                face->norm[c] = n;
+            }
+            else if (!Normalize(n))
+                n = m->faceNorm[f];
+            m->cornerNorm[f*3+c] = n;
+        }
+    }
+}
+
+/**
+ * Weld the full vertices of the faces in [begin;end) and compute their
+ * triangle data, as InitTriInfo() of MikkTSpace. Faces must be read in
+ * order, as the first good corner of each vertex is recorded.
+ */
+void TangentSpaceGenerator::ReadTriangles(Mesh* m, unsigned int begin, unsigned int end) {
+    for (unsigned int f = begin; f < end; f++) {
+        Face* face = m->faces[f];
+        for (unsigned int c = 0; c < 3; c++) {
+            MikkVertex v;
+            v.pos = face->vert[c];
+            v.norm = m->cornerNorm[f*3+c];
+            v.texc = face->texc[c];
+            unsigned int idx;
+            map<MikkVertex, unsigned int, MikkVertexLess>::iterator itr = m->vertices.find(v);
+            if (itr == m->vertices.end()) {
+                idx = m->firstGood.size();
+                m->vertices[v] = idx;
+                m->firstGood.push_back(NO_CORNER);
+            } else
+                idx = itr->second;
+            m->vertex[f*3+c] = idx;
+        }
+
+        Mesh::Triangle& t = m->tris[f];
+        t.flags = GROUP_WITH_ANY;
+        t.os = t.ot = Vector<3,float>(0.0,0.0,0.0);
+        t.magS = t.magT = 0.0;
+        for (unsigned int i = 0; i < 3; i++) {
+            t.neighbour[i] = NO_FACE;
+            t.group[i] = NO_GROUP;
+        }
+
+        const Vector<3,float>& p0 = face->vert[0];
+        const Vector<3,float>& p1 = face->vert[1];
+        const Vector<3,float>& p2 = face->vert[2];
+        if (p0 == p1 || p0 == p2 || p1 == p2) {
+            t.flags |= MARK_DEGENERATE;
+            continue;
+        }
+        for (unsigned int c = 0; c < 3; c++)
+            if (m->firstGood[m->vertex[f*3+c]] == NO_CORNER)
+                m->firstGood[m->vertex[f*3+c]] = f*3+c;
+
+        // tangent and bitangent in the directions of u and v
+        const Vector<2,float>* tc = face->texc;
+        float t21x = tc[1][0] - tc[0][0];
+        float t21y = tc[1][1] - tc[0][1];
+        float t31x = tc[2][0] - tc[0][0];
+        float t31y = tc[2][1] - tc[0][1];
+        Vector<3,float> d1 = VSub(p1, p0);
+        Vector<3,float> d2 = VSub(p2, p0);
+        float area = t21x*t31y - t21y*t31x;
+        Vector<3,float> os = VSub(VScale(t31y, d1), VScale(t21y, d2));
+        Vector<3,float> ot = VAdd(VScale(-t31x, d1), VScale(t21x, d2));
+        if (area > 0)
+            t.flags |= ORIENT_PRESERVING;
+
+        if (NotZero(area)) {
+            float absArea = std::fabs(area);
+            float lenOs = VLength(os);
+            float lenOt = VLength(ot);
+            float sign = (t.flags & ORIENT_PRESERVING) != 0 ? 1.0f : -1.0f;
+            if (NotZero(lenOs)) t.os = VScale(sign / lenOs, os);
+            if (NotZero(lenOt)) t.ot = VScale(sign / lenOt, ot);
+            t.magS = lenOs / absArea;
+            t.magT = lenOt / absArea;
+
+            // only triangles with a proper uv mapping start groups
+            if (NotZero(t.magS) && NotZero(t.magT))
+                t.flags &= ~GROUP_WITH_ANY;
+        }
+
+        for (unsigned int i = 0; i < 3; i++) {
+            unsigned int a = m->vertex[f*3+i];
+            unsigned int b = m->vertex[f*3+(i<2 ? i+1 : 0)];
+            m->edges[make_pair(a < b ? a : b, a < b ? b : a)].push_back(f);
+        }
+    }
+}
+
+/**
+ * Find the edge of face f between the vertices a and b.
+ *
+ * @return Edge index i, going from corner i to i+1, with its start
+ *         vertex in i0 and end vertex in i1.
+ */
+static unsigned int GetEdge(const vector<unsigned int>& vertex, unsigned int f,
+                            unsigned int a, unsigned int b,
+                            unsigned int& i0, unsigned int& i1) {
+    const unsigned int* v = &vertex[f*3];
+    unsigned int e;
+    if (v[0] == a) e = v[1] == b ? 0 : 2;
+    else if (v[1] == a) e = v[0] == b ? 0 : 1;
+    else e = v[0] == b ? 2 : 1;
+    i0 = v[e];
+    i1 = v[e<2 ? e+1 : 0];
+    return e;
+}
+
+/**
+ * Pair the edges of the good triangles into neighbours until the
+ * cursor reaches end. Edges are visited sorted by their vertices and
+ * faces, and each is paired with the first later, unpaired edge going
+ * the other way, as BuildNeighborsFast() of MikkTSpace.
+ */
+void TangentSpaceGenerator::PairEdges(Mesh* m, unsigned int end) {
+    while (m->cursor < end && m->edge != m->edges.end()) {
+        unsigned int a = m->edge->first.first;
+        unsigned int b = m->edge->first.second;
+        const vector<unsigned int>& faces = m->edge->second;
+        for (unsigned int i = 0; i < faces.size(); i++) {
+            unsigned int f = faces[i], i0A, i1A;
+            unsigned int eA = GetEdge(m->vertex, f, a, b, i0A, i1A);
+            if (m->tris[f].neighbour[eA] != NO_FACE)
+                continue;
+            for (unsigned int j = i + 1; j < faces.size(); j++) {
+                unsigned int g = faces[j], i0B, i1B;
+                unsigned int eB = GetEdge(m->vertex, g, a, b, i1B, i0B);
+                if (i0A == i0B && i1A == i1B && m->tris[g].neighbour[eB] == NO_FACE) {
+                    m->tris[f].neighbour[eA] = g;
+                    m->tris[g].neighbour[eB] = f;
+                    break;
+                }
+            }
+        }
+        m->cursor += faces.size();
+        m->edge++;
+    }
+}
+
+/**
+ * Build groups from the corners until the cursor reaches end, as
+ * Build4RuleGroups() of MikkTSpace. Each corner of a triangle with a
+ * proper uv mapping and no group starts a new group, which spreads to
+ * the neighbours sharing its vertex, left before right, as long as
+ * their orientation agrees.
+ */
+void TangentSpaceGenerator::BuildGroups(Mesh* m, unsigned int end) {
+    while (m->cursor < end) {
+        unsigned int f = m->cursor / 3;
+        unsigned int i = m->cursor % 3;
+        m->cursor++;
+        Mesh::Triangle& t = m->tris[f];
+        if ((t.flags & (MARK_DEGENERATE | GROUP_WITH_ANY)) != 0 ||
+            t.group[i] != NO_GROUP)
+            continue;
+
+        Mesh::Group group;
+        group.vertex = m->vertex[f*3+i];
+        group.orient = (t.flags & ORIENT_PRESERVING) != 0;
+        group.first = m->groupFaces.size();
+        group.count = 1;
+        unsigned int g = m->groups.size();
+        m->groups.push_back(group);
+        m->groupFaces.push_back(f);
+        t.group[i] = g;
+
+        // the recursion of the reference as a depth first walk
+        if (t.neighbour[i>0 ? i-1 : 2] != NO_FACE)
+            m->stack.push_back(t.neighbour[i>0 ? i-1 : 2]);
+        if (t.neighbour[i] != NO_FACE)
+            m->stack.push_back(t.neighbour[i]);
+        while (!m->stack.empty()) {
+            unsigned int n = m->stack.back();
+            m->stack.pop_back();
+            AssignTriangle(m, n, g);
+        }
+    }
+}
+
+/**
+ * Add face f to group g if it fits, as AssignRecur() of MikkTSpace,
+ * and schedule its neighbours around the vertex of the group.
+ */
+void TangentSpaceGenerator::AssignTriangle(Mesh* m, unsigned int f, unsigned int g) {
+    Mesh::Triangle& t = m->tris[f];
+    Mesh::Group& group = m->groups[g];
+    unsigned int i = 0;
+    while (i < 3 && m->vertex[f*3+i] != group.vertex)
+        i++;
+    if (i == 3 || t.group[i] != NO_GROUP)
+        return;
+
+    // the first group to reach a triangle without a proper uv mapping
+    // decides its orientation
+    if ((t.flags & GROUP_WITH_ANY) != 0 &&
+        t.group[0] == NO_GROUP && t.group[1] == NO_GROUP && t.group[2] == NO_GROUP) {
+        t.flags &= ~ORIENT_PRESERVING;
+        t.flags |= group.orient ? ORIENT_PRESERVING : 0;
+    }
+    if (((t.flags & ORIENT_PRESERVING) != 0) != group.orient)
+        return;
+
+    m->groupFaces.push_back(f);
+    group.count++;
+    t.group[i] = g;
+    if (t.neighbour[i>0 ? i-1 : 2] != NO_FACE)
+        m->stack.push_back(t.neighbour[i>0 ? i-1 : 2]);
+    if (t.neighbour[i] != NO_FACE)
+        m->stack.push_back(t.neighbour[i]);
+}
+
+/**
+ * Evaluate the tangent spaces of the grouped corners until the cursor
+ * reaches end, as GenerateTSpaces() of MikkTSpace. The faces of a
+ * group whose tangents agree with the tangent of a corner form its
+ * sub group, and equal sub groups share their tangent space.
+ */
+void TangentSpaceGenerator::EvalSpaces(Mesh* m, unsigned int end) {
+    vector<unsigned int> members;
+    while (m->cursor < end) {
+        while (m->member == m->groups[m->group].first + m->groups[m->group].count) {
+            m->group++;
+            m->subGroups.clear();
+        }
+        const Mesh::Group& group = m->groups[m->group];
+        unsigned int f = m->groupFaces[m->member++];
+        m->cursor += group.count;
+
+        const Mesh::Triangle& t = m->tris[f];
+        unsigned int i = t.group[0] == m->group ? 0 : (t.group[1] == m->group ? 1 : 2);
+        const Vector<3,float>& n = m->cornerNorm[f*3+i];
+        Vector<3,float> os = VProject(t.os, n);
+        Vector<3,float> ot = VProject(t.ot, n);
+
+        // collect the faces of the group with agreeing tangents
+        members.clear();
+        for (unsigned int j = group.first; j < group.first + group.count; j++) {
+            unsigned int g = m->groupFaces[j];
+            const Mesh::Triangle& u = m->tris[g];
+            Vector<3,float> os2 = VProject(u.os, n);
+            Vector<3,float> ot2 = VProject(u.ot, n);
+            bool any = ((t.flags | u.flags) & GROUP_WITH_ANY) != 0;
+            float cosS = Dot(os, os2);
+            float cosT = Dot(ot, ot2);
+            if (any || f == g || (cosS > THRES_COS && cosT > THRES_COS))
+                members.push_back(g);
+        }
+        sort(members.begin(), members.end());
+
+        unsigned int s = 0;
+        while (s < m->subGroups.size() && m->subGroups[s].faces != members)
+            s++;
+        if (s == m->subGroups.size()) {
+            Mesh::SubGroup sub;
+            sub.faces = members;
+            sub.os = EvalSpace(m, members, group.vertex);
+            m->subGroups.push_back(sub);
+        }
+
+        Mesh::Space& space = m->spaces[f*3+i];
+        space.os = m->subGroups[s].os;
+        space.orient = group.orient;
+    }
+}
+
+/**
+ * Compute the tangent of a sub group at the given vertex, as
+ * EvalTspace() of MikkTSpace: the angle weighted sum of the member
+ * tangents projected onto the plane of the vertex normal.
+ */
+Vector<3,float> TangentSpaceGenerator::EvalSpace(Mesh* m, const vector<unsigned int>& members,
+                                                 unsigned int vertex) {
+    Vector<3,float> os(0.0,0.0,0.0);
+    for (unsigned int k = 0; k < members.size(); k++) {
+        unsigned int f = members[k];
+        const Mesh::Triangle& t = m->tris[f];
+        if ((t.flags & GROUP_WITH_ANY) != 0)
+            continue;
+        unsigned int i = 0;
+        while (i < 2 && m->vertex[f*3+i] != vertex)
+            i++;
+
+        const Vector<3,float>& n = m->cornerNorm[f*3+i];
+        Vector<3,float> vos = VProject(t.os, n);
+
+        // angle of the corner in the plane of the normal
+        const Face* face = m->faces[f];
+        const Vector<3,float>& p0 = face->vert[i>0 ? i-1 : 2];
+        const Vector<3,float>& p1 = face->vert[i];
+        const Vector<3,float>& p2 = face->vert[i<2 ? i+1 : 0];
+        Vector<3,float> v1 = VProject(VSub(p0, p1), n);
+        Vector<3,float> v2 = VProject(VSub(p2, p1), n);
+        float c = Dot(v1, v2);
+        c = c > 1 ? 1 : (c < -1 ? -1 : c);
+        float a = (float)acos((double)c);
+
+        os = VAdd(os, VScale(a, vos));
+    }
+    return VNotZero(os) ? VNormalize(os) : os;
+}
+
+/**
+ * Write the tangent frames of the faces in [begin;end). Degenerate
+ * triangles take the tangent space of the first good corner at the
+ * same vertex, as DegenEpilogue() of MikkTSpace.
+ */
+void TangentSpaceGenerator::WriteTangents(Mesh* m, unsigned int begin, unsigned int end) {
+    for (unsigned int f = begin; f < end; f++) {
+        bool degenerate = (m->tris[f].flags & MARK_DEGENERATE) != 0;
+        FaceTangents& out = (*m->tangents)[f];
+        for (unsigned int c = 0; c < 3; c++) {
+            unsigned int k = f*3+c;
+            if (degenerate && m->firstGood[m->vertex[k]] != NO_CORNER)
+                k = m->firstGood[m->vertex[k]];
+            const Mesh::Space& space = m->spaces[k];
+            const Vector<3,float>& t = space.os;
+            float sign = space.orient ? 1.0f : -1.0f;
+            out.tangent[c] = Vector<4,float>(t[0], t[1], t[2], sign);
+            out.bitangent[c] = Cross(m->cornerNorm[f*3+c], t) * sign;
+        }
+    }
+}
+
+} // NS Resources
+} // NS OpenEngine
@@ -0,0 +1,119 @@
+// Normal and tangent space generation for imported meshes.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _TANGENT_SPACE_GENERATOR_H_
+#define _TANGENT_SPACE_GENERATOR_H_
+
+#include <Math/Vector.h>
+
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
+namespace OpenEngine {
+    namespace Geometry {
+        class Face;
+        class FaceSet;
+    }
+
+namespace Resources {
+
+using namespace OpenEngine::Geometry;
+using OpenEngine::Math::Vector;
+using namespace std;
+
+class ColladaJobQueue;
+
+/**
+ * Per face tangent frame.
+ * The w component of the tangent holds the handedness, such that
+ * bitangent = w * cross(normal, tangent.xyz).
+ */
+struct FaceTangents {
+    Vector<4,float> tangent[3];
+    Vector<3,float> bitangent[3];
+};
+
+//! Tangent frames in FaceSet iteration order.
+typedef vector<FaceTangents> TangentList;
+
+//! Tangent list shared by the face sets of all instances of a mesh.
+typedef boost::shared_ptr<TangentList> TangentListPtr;
+
+/**
+ * Generates smooth vertex normals and tangent frames for face sets.
+ *
+ * Positions are welded and normals are averaged over the faces
+ * sharing a position, weighted by the corner angle, as long as the
+ * faces lie within the crease angle of each other.
+ *
+ * Tangents are a port of MikkTSpace, the reference implementation by
+ * Morten Mikkelsen that most baking tools use, with its default
+ * angular threshold of 180 degrees. Corners are welded by position,
+ * normal and uv, and the triangles are grouped around each vertex
+ * across shared edges by the four rules of the reference. Degenerate
+ * triangles are left out and copy the tangent of the first good corner
+ * at the same vertex. The tangent of a corner is the angle
+ * weighted sum of the projected tangents of its sub group. Groups,
+ * sub groups and sums are visited in the same order and computed with
+ * the same float operations as in the reference, so normal maps baked
+ * against MikkTSpace match the imported tangents.
+ *
+ * Meshes are processed in parallel and large meshes are further
+ * split into chunks of faces. Processing can be spread over a number
+ * of calls to Step(), each handling a bounded amount of work.
+ *
+ * @class TangentSpaceGenerator TangentSpaceGenerator.h "TangentSpaceGenerator.h"
+ */
+class TangentSpaceGenerator {
+private:
+    struct Mesh;
+    class PhaseJob;
+    class ChunkJob;
+
+    vector<Mesh*> meshes;
+    float cosCrease;
+    unsigned int chunkSize;
+    unsigned int threads;
+
+    static void Prepare(Mesh* m);
+    static void Advance(Mesh* m);
+    static bool IsChunked(Mesh* m);
+    static void RunPhase(Mesh* m, unsigned int budget);
+    static void RunChunk(Mesh* m, float cosCrease,
+                         unsigned int begin, unsigned int end);
+    static void Weld(Mesh* m, unsigned int begin, unsigned int end);
+    static void ProcessNormals(Mesh* m, float cosCrease,
+                               unsigned int begin, unsigned int end);
+    static void ReadTriangles(Mesh* m, unsigned int begin, unsigned int end);
+    static void PairEdges(Mesh* m, unsigned int end);
+    static void BuildGroups(Mesh* m, unsigned int end);
+    static void AssignTriangle(Mesh* m, unsigned int f, unsigned int g);
+    static void EvalSpaces(Mesh* m, unsigned int end);
+    static Vector<3,float> EvalSpace(Mesh* m, const vector<unsigned int>& members,
+                                     unsigned int vertex);
+    static void WriteTangents(Mesh* m, unsigned int begin, unsigned int end);
+
+public:
+    TangentSpaceGenerator();
+    virtual ~TangentSpaceGenerator();
+
+    void SetCreaseAngle(float radians);
+    void SetChunkSize(unsigned int faces);
+    void SetThreadCount(unsigned int threads);
+
+    void AddMesh(FaceSet* fs, const vector<bool>& genNormals, TangentList* tangents);
+    unsigned int Step(unsigned int budget);
+    bool IsDone();
+    void Run();
+};
+
+} // NS Resources
+} // NS OpenEngine
+
+#endif // _TANGENT_SPACE_GENERATOR_H_